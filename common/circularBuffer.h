@@ -28,6 +28,124 @@
 #pragma once
 #include "type_traits.h"
 #include <stddef.h>
+#include <string.h>
+#if defined(__ICCSTM8__)
+#include <intrinsics.h>
+#endif
+
+// Single producer / single consumer contract: one side (e.g. an ISR) only writes,
+// the other one (e.g. the main loop) only reads. Each index is modified by its owner only,
+// the other side just loads it. Loads and stores of the indexes go through CircularBufferIndex,
+// which makes them atomic, element copies go through CircularBufferData, which orders them against the indexes.
+// The owner reads its own index with LoadOwn: nobody else stores to it, so the read can't be torn.
+
+#if defined(MCUDRV_HOST)
+// Host build: producer and consumer may run in different threads, acquire/release on the indexes orders the data
+template<typename T>
+struct CircularBufferIndex
+{
+    static T Load(const volatile T& index)
+    {
+        return __atomic_load_n(&index, __ATOMIC_ACQUIRE);
+    }
+    static T LoadOwn(const volatile T& index)
+    {
+        return __atomic_load_n(&index, __ATOMIC_RELAXED);
+    }
+    static void Store(volatile T& index, T value)
+    {
+        __atomic_store_n(&index, value, __ATOMIC_RELEASE);
+    }
+};
+struct CircularBufferData
+{
+    static void Barrier()
+    { }
+    template<typename T>
+    static void Copy(T* dst, const T* src, size_t n)
+    {
+        memcpy(dst, src, n * sizeof(T));
+    }
+    template<typename T>
+    static void CopyBulk(T* dst, const T* src, size_t n)
+    {
+        memcpy(dst, src, n * sizeof(T));
+    }
+};
+#else
+// Single byte index: plain access is atomic on 8-bit core
+template<typename T, bool SingleByte = sizeof(T) == 1>
+struct CircularBufferIndex
+{
+    static T Load(const volatile T& index)
+    {
+        return index;
+    }
+    static T LoadOwn(const volatile T& index)
+    {
+        return index;
+    }
+    static void Store(volatile T& index, T value)
+    {
+        index = value;
+    }
+};
+// Multibyte index may be torn by an interrupt, so the other side's index is loaded and the own one
+// is stored with interrupts disabled.
+// Interrupt state is restored, hence it's safe to use from ISR as well.
+template<typename T>
+struct CircularBufferIndex<T, false>
+{
+    static T LoadOwn(const volatile T& index)
+    {
+        return index;
+    }
+    static T Load(const volatile T& index)
+    {
+        __istate_t state = __get_interrupt_state();
+        __disable_interrupt();
+        T value = index;
+        __set_interrupt_state(state);
+        return value;
+    }
+    static void Store(volatile T& index, T value)
+    {
+        __istate_t state = __get_interrupt_state();
+        __disable_interrupt();
+        index = value;
+        __set_interrupt_state(state);
+    }
+};
+// The compiler keeps only volatile accesses in program order, the data has to be ordered against the indexes:
+// a write can't sink below the index store, a read can't rise above the index load.
+// Single elements are copied through volatile pointers. Bulk copies are done by memcpy between compiler
+// barriers: inline assembler is opaque to the compiler, memory accesses aren't moved across it.
+// Span users (GetWriteSpan/GetReadSpan) on the main loop side have to copy the data the same way, or put
+// a Barrier() between the data access and CommitWrite, and between GetReadSpan and the data access.
+struct CircularBufferData
+{
+    static void Barrier()
+    {
+        __asm("");
+    }
+    template<typename T>
+    static void Copy(T* dst, const T* src, size_t n)
+    {
+        volatile unsigned char* d = reinterpret_cast<volatile unsigned char*>(dst);
+        const volatile unsigned char* s = reinterpret_cast<const volatile unsigned char*>(src);
+        for(n *= sizeof(T); n; --n) {
+            *d++ = *s++;
+        }
+    }
+    template<typename T>
+    static void CopyBulk(T* dst, const T* src, size_t n)
+    {
+        Barrier();
+        memcpy(dst, src, n * sizeof(T));
+        Barrier();
+    }
+};
+#endif
 
 template<size_t SIZE, typename DATA_T = unsigned char>
 class CircularBuffer
@@ -36,27 +154,105 @@ public:
     typedef typename stdx::SelectSizeForLength<SIZE>::type INDEX_T;
 private:
     static_assert((SIZE & (SIZE - 1)) == 0, "SIZE must be a power of 2");
+    typedef CircularBufferIndex<INDEX_T> Index;
     DATA_T _data[SIZE];
     volatile INDEX_T _readCount;
     volatile INDEX_T _writeCount;
     static const INDEX_T _mask = SIZE - 1;
 public:
+    // Producer side
     bool Write(DATA_T value)
     {
-        if(IsFull())
+        INDEX_T writeCount = Index::LoadOwn(_writeCount);
+        if((INDEX_T)(writeCount - Index::Load(_readCount)) >= SIZE)
             return false;
-        _data[_writeCount++ & _mask] = value;
+        CircularBufferData::Copy(&_data[writeCount & _mask], &value, 1);
+        Index::Store(_writeCount, writeCount + 1);
         return true;
     }
 
+    // Consumer side
     bool Read(DATA_T& value)
     {
-        if(IsEmpty())
+        INDEX_T readCount = Index::LoadOwn(_readCount);
+        if(Index::Load(_writeCount) == readCount)
             return false;
-        value = _data[_readCount++ & _mask];
+        CircularBufferData::Copy(&value, &_data[readCount & _mask], 1);
+        Index::Store(_readCount, readCount + 1);
         return true;
     }
 
+    // Zero-copy access. GetWriteSpan/GetReadSpan return the length of the largest contiguous
+    // free/filled region and point ptr at its start. The region is handed over by CommitWrite/ConsumeRead.
+    INDEX_T GetWriteSpan(DATA_T*& ptr)
+    {
+        INDEX_T writeCount = Index::LoadOwn(_writeCount);
+        INDEX_T free = (INDEX_T)(SIZE - (INDEX_T)(writeCount - Index::Load(_readCount)));
+        INDEX_T offset = writeCount & _mask;
+        INDEX_T toEnd = (INDEX_T)(SIZE - offset);
+        ptr = &_data[offset];
+        return free < toEnd ? free : toEnd;
+    }
+
+    void CommitWrite(INDEX_T n)
+    {
+        Index::Store(_writeCount, Index::LoadOwn(_writeCount) + n);
+    }
+
+    INDEX_T GetReadSpan(const DATA_T*& ptr) const
+    {
+        INDEX_T readCount = Index::LoadOwn(_readCount);
+        INDEX_T avail = (INDEX_T)(Index::Load(_writeCount) - readCount);
+        INDEX_T offset = readCount & _mask;
+        INDEX_T toEnd = (INDEX_T)(SIZE - offset);
+        ptr = &_data[offset];
+        return avail < toEnd ? avail : toEnd;
+    }
+
+    void ConsumeRead(INDEX_T n)
+    {
+        Index::Store(_readCount, Index::LoadOwn(_readCount) + n);
+    }
+    // Bulk write, returns number of elements actually written
+    INDEX_T Write(const DATA_T* buf, size_t n)
+    {
+        INDEX_T total = 0;
+        DATA_T* ptr;
+        for(uint8_t pass = 0; pass < 2 && n; ++pass) {
+            INDEX_T len = GetWriteSpan(ptr);
+            if(!len)
+                break;
+            if(len > n)
+                len = (INDEX_T)n;
+            CircularBufferData::CopyBulk(ptr, buf, len);
+            CommitWrite(len);
+            buf += len;
+            n -= len;
+            total += len;
+        }
+        return total;
+    }
+
+    // Bulk read, returns number of elements actually read
+    INDEX_T Read(DATA_T* buf, size_t n)
+    {
+        INDEX_T total = 0;
+        const DATA_T* ptr;
+        for(uint8_t pass = 0; pass < 2 && n; ++pass) {
+            INDEX_T len = GetReadSpan(ptr);
+            if(!len)
+                break;
+            if(len > n)
+                len = (INDEX_T)n;
+            CircularBufferData::CopyBulk(buf, ptr, len);
+            ConsumeRead(len);
+            buf += len;
+            n -= len;
+            total += len;
+        }
+        return total;
+    }
+
     DATA_T First() const
     {
         return operator[](0);
@@ -64,44 +260,44 @@ public:
 
     DATA_T Last() const
     {
-        return operator[](Count());
+        return operator[](Count() - 1);
     }
 
+    // No bounds checking
     DATA_T& operator[](INDEX_T i)
     {
-        if(IsEmpty() || i > Count())
-            return DATA_T();
-        return _data[(_readCount + i) & _mask];
+        return _data[(Index::Load(_readCount) + i) & _mask];
     }
 
     const DATA_T operator[](INDEX_T i) const
     {
-        if(IsEmpty() || i > Count())
+        if(i >= Count())
             return DATA_T();
-        return _data[(_readCount + i) & _mask];
+        return _data[(Index::Load(_readCount) + i) & _mask];
     }
 
     bool IsEmpty() const
     {
-        INDEX_T temp = _readCount;
-        return _writeCount == temp;
+        INDEX_T temp = Index::Load(_readCount);
+        return Index::Load(_writeCount) == temp;
     }
 
     bool IsFull() const
     {
-        INDEX_T temp = _readCount;
-        return ((_writeCount - temp) & (INDEX_T) ~(_mask)) != 0;
+        return Count() >= SIZE;
     }
 
     INDEX_T Count() const
     {
-        return (_writeCount - _readCount) & _mask;
+        INDEX_T temp = Index::Load(_readCount);
+        return (INDEX_T)(Index::Load(_writeCount) - temp);
     }
 
+    // Not a part of SPSC contract, both sides must be idle
     void Clear()
     {
-        _readCount = 0;
-        _writeCount = 0;
+        Index::Store(_readCount, 0);
+        Index::Store(_writeCount, 0);
     }
 
     INDEX_T Size()
@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+#ifndef FILTERS_H
+#define FILTERS_H
+
+#include <stdint.h>
+
+// Filters for sample streams, each Update and query is O(1): no loops over the window
+// (the median sorts a copy of a fixed small N). The first sample primes the state,
+// so there is no settling from zero.
+
+namespace utils {
+namespace Internal {
+template<typename T>
+struct FilterTraits;
+template<>
+struct FilterTraits<uint8_t>
+{
+    typedef uint16_t sum_type;
+};
+template<>
+struct FilterTraits<int8_t>
+{
+    typedef int16_t sum_type;
+};
+template<>
+struct FilterTraits<uint16_t>
+{
+    typedef uint32_t sum_type;
+};
+template<>
+struct FilterTraits<int16_t>
+{
+    typedef int32_t sum_type;
+};
+} // Internal
+
+// Simple moving average with a running sum, Size samples window
+template<typename T, uint8_t Size, typename SumT = typename Internal::FilterTraits<T>::sum_type>
+class MovingAverage
+{
+private:
+    T window_[Size];
+    SumT sum_;
+    uint8_t index_;
+    bool primed_;
+public:
+    MovingAverage() : sum_(0), index_(0), primed_(false)
+    { }
+    void Reset(const T value)
+    {
+        for(uint8_t i = 0; i < Size; ++i) {
+            window_[i] = value;
+        }
+        sum_ = SumT(value) * Size;
+        index_ = 0;
+        primed_ = true;
+    }
+    void Update(const T value)
+    {
+        if(!primed_) {
+            Reset(value);
+            return;
+        }
+        sum_ += value;
+        sum_ -= window_[index_];
+        window_[index_] = value;
+        if(++index_ == Size) {
+            index_ = 0;
+        }
+    }
+    SumT GetSum() const
+    {
+        return sum_;
+    }
+    T Get() const
+    {
+        return T(sum_ / Size);
+    }
+};
+
+// Exponential moving average, alpha = 1 / 2^Shift. The state keeps Shift fraction bits.
+template<typename T, uint8_t Shift, typename SumT = typename Internal::FilterTraits<T>::sum_type>
+class Ema
+{
+private:
+    SumT acc_;
+    bool primed_;
+public:
+    Ema() : acc_(0), primed_(false)
+    { }
+    void Reset(const T value)
+    {
+        acc_ = SumT(value) << Shift;
+        primed_ = true;
+    }
+    void Update(const T value)
+    {
+        if(!primed_) {
+            Reset(value);
+            return;
+        }
+        acc_ += SumT(value) - (acc_ >> Shift);
+    }
+    T Get() const
+    {
+        return T(acc_ >> Shift);
+    }
+    // Average times Mult with the fraction bits kept until the end: (state * Mult) >> Shift.
+    // Scaling Get() loses up to Mult - 1 of the result. The product must fit SumT.
+    template<uint16_t Mult>
+    SumT GetScaled() const
+    {
+        return SumT(acc_ * Mult) >> Shift;
+    }
+};
+
+// Median of the last N samples for spike rejection, N is small and odd
+template<typename T, uint8_t N = 3>
+class Median
+{
+private:
+    static_assert(N & 1, "N should be odd");
+    static_assert(N <= 7, "Median is intended for small N");
+    T window_[N];
+    uint8_t index_;
+    bool primed_;
+public:
+    Median() : index_(0), primed_(false)
+    { }
+    void Reset(const T value)
+    {
+        for(uint8_t i = 0; i < N; ++i) {
+            window_[i] = value;
+        }
+        index_ = 0;
+        primed_ = true;
+    }
+    void Update(const T value)
+    {
+        if(!primed_) {
+            Reset(value);
+            return;
+        }
+        window_[index_] = value;
+        if(++index_ == N) {
+            index_ = 0;
+        }
+    }
+    T Get() const
+    {
+        T sorted[N];
+        for(uint8_t i = 0; i < N; ++i) {
+            const T value = window_[i];
+            uint8_t j = i;
+            for(; j && sorted[j - 1] > value; --j) {
+                sorted[j] = sorted[j - 1];
+            }
+            sorted[j] = value;
+        }
+        return sorted[N / 2];
+    }
+};
+
+template<typename T>
+class Median<T, 3>
+{
+private:
+    T a_, b_, c_;
+    bool primed_;
+public:
+    Median() : primed_(false)
+    { }
+    void Reset(const T value)
+    {
+        a_ = b_ = c_ = value;
+        primed_ = true;
+    }
+    void Update(const T value)
+    {
+        if(!primed_) {
+            Reset(value);
+            return;
+        }
+        a_ = b_;
+        b_ = c_;
+        c_ = value;
+    }
+    T Get() const
+    {
+        if(a_ > b_) {
+            return b_ > c_ ? b_ : a_ > c_ ? c_ : a_;
+        }
+        return a_ > c_ ? a_ : b_ > c_ ? c_ : b_;
+    }
+};
+
+// Lowest and highest value since the last Reset
+template<typename T>
+class MinMax
+{
+private:
+    T min_, max_;
+    bool primed_;
+public:
+    MinMax() : primed_(false)
+    { }
+    void Reset()
+    {
+        primed_ = false;
+    }
+    void Update(const T value)
+    {
+        if(!primed_) {
+            min_ = max_ = value;
+            primed_ = true;
+        }
+        else if(value < min_) {
+            min_ = value;
+        }
+        else if(value > max_) {
+            max_ = value;
+        }
+    }
+    bool IsEmpty() const
+    {
+        return !primed_;
+    }
+    T GetMin() const
+    {
+        return min_;
+    }
+    T GetMax() const
+    {
+        return max_;
+    }
+};
+
+} // utils
+
+#endif // FILTERS_H
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+#ifndef FIXED_H
+#define FIXED_H
+
+#include "format.h"
+#include "type_traits.h"
+
+namespace utils {
+namespace Internal {
+
+template<typename T>
+struct FixedTraits;
+template<>
+struct FixedTraits<uint8_t>
+{
+    typedef int16_t wide_type;
+    typedef uint16_t product_type;
+    typedef uint32_t scale_type;
+    static const uint8_t min = 0;
+    static const uint8_t max = UINT8_MAX;
+};
+template<>
+struct FixedTraits<int8_t>
+{
+    typedef int16_t wide_type;
+    typedef int16_t product_type;
+    typedef int32_t scale_type;
+    static const int8_t min = INT8_MIN;
+    static const int8_t max = INT8_MAX;
+};
+template<>
+struct FixedTraits<uint16_t>
+{
+    typedef int32_t wide_type;
+    typedef uint32_t product_type;
+    typedef uint32_t scale_type;
+    static const uint16_t min = 0;
+    static const uint16_t max = UINT16_MAX;
+};
+template<>
+struct FixedTraits<int16_t>
+{
+    typedef int32_t wide_type;
+    typedef int32_t product_type;
+    typedef int32_t scale_type;
+    static const int16_t min = INT16_MIN;
+    static const int16_t max = INT16_MAX;
+};
+
+template<uint8_t Decimals>
+struct DecimalScale
+{
+    static const uint32_t value = 10UL * DecimalScale<Decimals - 1>::value;
+};
+template<>
+struct DecimalScale<0>
+{
+    static const uint32_t value = 1;
+};
+
+// Multiplier and shift to replace multiplication by Num / Den.
+// The largest shift which keeps the multiplier in 16 bits is chosen.
+template<uint32_t Num, uint32_t Den, uint8_t Shift = 16, bool Fits = ((Num << Shift) / Den < 0x10000UL)>
+struct ScaleFactor : ScaleFactor<Num, Den, Shift - 1>
+{
+};
+template<uint32_t Num, uint32_t Den, uint8_t Shift>
+struct ScaleFactor<Num, Den, Shift, true>
+{
+    static const uint16_t multiplier = ((Num << Shift) + Den / 2) / Den;
+    static const uint8_t shift = Shift;
+};
+
+} // Internal
+
+// Binary fixed point number with FracBits fractional bits, stored in 8 or 16-bit integer.
+// Arithmetic saturates at the limits of IntT instead of wrapping around.
+template<typename IntT, uint8_t FracBits>
+class Fixed
+{
+    typedef Internal::FixedTraits<IntT> Traits;
+    typedef typename Traits::wide_type wide_type;
+    typedef typename Traits::product_type product_type;
+    typedef typename Traits::scale_type scale_type; // raw value by 16-bit multiplier, unsigned for unsigned IntT
+    static_assert(FracBits < sizeof(IntT) * 8, "Too many fractional bits");
+    IntT raw_;
+
+    template<typename W>
+    static IntT Saturate(W value)
+    {
+        return value > W(Traits::max) ? Traits::max : value < W(Traits::min) ? Traits::min : IntT(value);
+    }
+public:
+    typedef IntT raw_type;
+    enum
+    {
+        frac_bits = FracBits
+    };
+
+    Fixed() : raw_()
+    { }
+    static Fixed FromRaw(IntT raw)
+    {
+        Fixed result;
+        result.raw_ = raw;
+        return result;
+    }
+    static Fixed FromInt(IntT value)
+    {
+        return FromRaw(Saturate(wide_type(value) << FracBits));
+    }
+    // Constant Num / Den, computed at compile time
+    template<int32_t Num, int32_t Den>
+    static Fixed FromRatio()
+    {
+        static const int32_t twice = Num * (1L << FracBits) * 2 / Den;
+        static const int32_t raw = (twice + (twice < 0 ? -1 : 1)) / 2;
+        static_assert(raw >= Traits::min && raw <= Traits::max, "Value is out of range");
+        return FromRaw(IntT(raw));
+    }
+
+    IntT Raw() const
+    {
+        return raw_;
+    }
+    IntT ToInt() const
+    {
+        return raw_ >> FracBits;
+    }
+    // Value multiplied by 10^Decimals and rounded, ready for io::Fixed<Decimals>
+    template<uint8_t Decimals>
+    int32_t ToDecimal() const
+    {
+        const int32_t scale = Internal::DecimalScale<Decimals>::value;
+        return ((int32_t)raw_ * scale + ((1L << FracBits) >> 1)) >> FracBits;
+    }
+
+    // Multiplication by constant Num / Den without division
+    template<uint32_t Num, uint32_t Den>
+    Fixed Scale() const
+    {
+        static_assert(Num < 0x10000UL && Den < 0x10000UL && Den, "Scale factor terms must fit in 16 bits");
+        typedef Internal::ScaleFactor<Num, Den> Factor;
+        scale_type result = (scale_type)raw_ * Factor::multiplier;
+        if(Factor::shift) {
+            result = (result + ((scale_type(1) << Factor::shift) >> 1)) >> Factor::shift;
+        }
+        return FromRaw(Saturate(result));
+    }
+
+    Fixed& operator+=(Fixed other)
+    {
+        raw_ = Saturate(wide_type(raw_) + other.raw_);
+        return *this;
+    }
+    Fixed& operator-=(Fixed other)
+    {
+        raw_ = Saturate(wide_type(raw_) - other.raw_);
+        return *this;
+    }
+    Fixed& operator*=(Fixed other)
+    {
+        raw_ = Saturate((product_type(raw_) * other.raw_) >> FracBits);
+        return *this;
+    }
+    friend Fixed operator+(Fixed a, Fixed b)
+    {
+        return a += b;
+    }
+    friend Fixed operator-(Fixed a, Fixed b)
+    {
+        return a -= b;
+    }
+    friend Fixed operator*(Fixed a, Fixed b)
+    {
+        return a *= b;
+    }
+    friend bool operator<(Fixed a, Fixed b)
+    {
+        return a.raw_ < b.raw_;
+    }
+    friend bool operator>(Fixed a, Fixed b)
+    {
+        return a.raw_ > b.raw_;
+    }
+    friend bool operator==(Fixed a, Fixed b)
+    {
+        return a.raw_ == b.raw_;
+    }
+    friend bool operator!=(Fixed a, Fixed b)
+    {
+        return a.raw_ != b.raw_;
+    }
+};
+
+} // utils
+
+namespace io {
+// Prints utils::Fixed value with FracDigits decimals
+template<uint8_t FracDigits, uint8_t Width = 0, char Fill = ' ', typename IntT, uint8_t FracBits>
+inline DecFormat<int32_t, Width, Fill, FracDigits> Fixed(utils::Fixed<IntT, FracBits> value)
+{
+    DecFormat<int32_t, Width, Fill, FracDigits> f = { value.template ToDecimal<FracDigits>() };
+    return f;
+}
+} // io
+
+#endif // FIXED_H
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "format.h"
+
+namespace io {
+const uint8_t Pow10<uint8_t>::table[] = { 100, 10, 1 };
+const uint16_t Pow10<uint16_t>::table[] = { 10000, 1000, 100, 10, 1 };
+const uint32_t Pow10<uint32_t>::table[] = { 1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL, 10000UL,
+                                            1000UL,       100UL,       10UL,       1UL };
+#if defined(UINT64_MAX)
+const uint64_t Pow10<uint64_t>::table[] = { 10000000000000000000ULL, 1000000000000000000ULL, 100000000000000000ULL,
+                                            10000000000000000ULL,    1000000000000000ULL,    100000000000000ULL,
+                                            10000000000000ULL,       1000000000000ULL,       100000000000ULL,
+                                            10000000000ULL,          1000000000ULL,          100000000ULL,
+                                            10000000ULL,             1000000ULL,             100000ULL,
+                                            10000ULL,                1000ULL,                100ULL,
+                                            10ULL,                   1ULL };
+#endif
+} // io
@@ -0,0 +1,386 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include "type_traits.h"
+
+// Type safe formatted output. The format of every argument is given by its type
+// (io::Dec, io::Hex, io::Fixed wrappers with width and fill as template parameters), so there is
+// nothing to parse at run time and only conversions for the types actually printed are instantiated.
+// Digits are produced most significant first and sent straight to the sink, without a buffer.
+//
+// Sink is any class with Putch(uint8_t), e.g. Uarts::UartIrq, Uarts::Uart or Hd44780:
+//   io::Print<Uart>("U=", io::Fixed<2>(voltage), "V, ", io::Hex<4>(status), '\n');
+// The same with a format string, each {} is replaced by the next argument. IO_FMT checks the braces and
+// PrintF the number of arguments at compile time, the text is written as is:
+//   io::PrintF<Uart>(IO_FMT("U={}V, {}\n"), io::Fixed<2>(voltage), io::Hex<4>(status));
+
+namespace io {
+
+// Powers of ten in descending order, used for digit extraction by subtraction and digit counting
+template<typename UT>
+struct Pow10;
+template<>
+struct Pow10<uint8_t>
+{
+    enum
+    {
+        count = 3
+    };
+    static const uint8_t table[count];
+};
+template<>
+struct Pow10<uint16_t>
+{
+    enum
+    {
+        count = 5
+    };
+    static const uint16_t table[count];
+};
+template<>
+struct Pow10<uint32_t>
+{
+    enum
+    {
+        count = 10
+    };
+    static const uint32_t table[count];
+};
+#if defined(UINT64_MAX)
+template<>
+struct Pow10<uint64_t>
+{
+    enum
+    {
+        count = 20
+    };
+    static const uint64_t table[count];
+};
+#endif
+
+namespace Internal {
+// Fixed width type of the same size, the tables are shared by all unsigned types of that size
+template<size_t Size>
+struct UnsignedOfSize;
+template<>
+struct UnsignedOfSize<1>
+{
+    typedef uint8_t type;
+};
+template<>
+struct UnsignedOfSize<2>
+{
+    typedef uint16_t type;
+};
+template<>
+struct UnsignedOfSize<4>
+{
+    typedef uint32_t type;
+};
+#if defined(UINT64_MAX)
+template<>
+struct UnsignedOfSize<8>
+{
+    typedef uint64_t type;
+};
+#endif
+} // Internal
+
+// ---=== Format specifiers ===---
+
+template<typename T, uint8_t Width, char Fill, uint8_t FracDigits>
+struct DecFormat
+{
+    T value;
+};
+template<typename T, uint8_t Width, char Fill>
+struct HexFormat
+{
+    T value;
+};
+// Format string made by IO_FMT, carries the number of {} placeholders
+template<uint8_t Placeholders>
+struct Format
+{
+    const char* str;
+};
+enum
+{
+    FormatMaxLength = 64
+};
+
+// Decimal, right aligned in Width characters
+template<uint8_t Width = 0, char Fill = ' ', typename T>
+inline DecFormat<T, Width, Fill, 0> Dec(T value)
+{
+    DecFormat<T, Width, Fill, 0> f = { value };
+    return f;
+}
+// Fixed point: value is scaled by 10^FracDigits, Fixed<2>(1234) prints "12.34"
+template<uint8_t FracDigits, uint8_t Width = 0, char Fill = ' ', typename T>
+inline DecFormat<T, Width, Fill, FracDigits> Fixed(T value)
+{
+    DecFormat<T, Width, Fill, FracDigits> f = { value };
+    return f;
+}
+// Hexadecimal, zero padded to Width digits
+template<uint8_t Width = 0, char Fill = '0', typename T>
+inline HexFormat<T, Width, Fill> Hex(T value)
+{
+    HexFormat<T, Width, Fill> f = { value };
+    return f;
+}
+
+namespace Internal {
+
+template<typename Sink>
+void PutFill(Sink& sink, char fill, uint8_t count)
+{
+    while(count--) {
+        sink.Putch(fill);
+    }
+}
+
+template<typename Sink, typename UT>
+void PutDec(Sink& sink, UT value, bool negative, uint8_t width, char fill, uint8_t fracDigits)
+{
+    typedef Pow10<typename UnsignedOfSize<sizeof(UT)>::type> Pow;
+    uint8_t index = 0;
+    uint8_t digits = Pow::count;
+    while(digits > fracDigits + 1 && value < Pow::table[index]) {
+        --digits;
+        ++index;
+    }
+    // fraction as long as the type or longer: zeros ahead of the table digits, "0." at least
+    const uint8_t lead = fracDigits >= digits ? fracDigits + 1 - digits : 0;
+    uint8_t len = lead + digits + negative + (fracDigits != 0);
+    if(fill != '0' && width > len) {
+        PutFill(sink, fill, width - len);
+    }
+    if(negative) {
+        sink.Putch('-');
+    }
+    if(fill == '0' && width > len) {
+        PutFill(sink, fill, width - len);
+    }
+    for(uint8_t i = 0; i < lead; ++i) {
+        if(lead + Pow::count - i == fracDigits) {
+            sink.Putch('.');
+        }
+        sink.Putch('0');
+    }
+    for(; index < Pow::count; ++index) {
+        if(fracDigits && Pow::count - index == fracDigits) {
+            sink.Putch('.');
+        }
+        const UT pow = Pow::table[index];
+        uint8_t digit = '0';
+        while(value >= pow) {
+            value -= pow;
+            ++digit;
+        }
+        sink.Putch(digit);
+    }
+}
+
+template<typename Sink, typename UT>
+void PutHex(Sink& sink, UT value, uint8_t width, char fill)
+{
+    uint8_t digits = sizeof(UT) * 2;
+    while(digits > 1 && !(value >> ((digits - 1) * 4))) {
+        --digits;
+    }
+    if(width > digits) {
+        PutFill(sink, fill, width - digits);
+    }
+    while(digits--) {
+        const uint8_t nibble = (value >> (digits * 4)) & 0x0F;
+        sink.Putch(uint8_t(nibble < 10 ? '0' + nibble : 'A' - 10 + nibble));
+    }
+}
+
+template<typename Sink, typename T>
+void WriteDec(Sink& sink, T value, uint8_t width, char fill, uint8_t fracDigits)
+{
+    typedef typename stdx::make_unsigned<T>::type UT;
+    const bool negative = stdx::is_negative(value);
+    PutDec<Sink, UT>(sink, negative ? UT(UT(0) - UT(value)) : UT(value), negative, width, fill, fracDigits);
+}
+
+template<typename Sink>
+inline void Write(Sink& sink, const char* s)
+{
+    while(*s) {
+        sink.Putch(*s++);
+    }
+}
+template<typename Sink>
+inline void Write(Sink& sink, char* s)
+{
+    Write(sink, (const char*)s);
+}
+template<typename Sink>
+inline void Write(Sink& sink, char c)
+{
+    sink.Putch(c);
+}
+template<typename Sink, typename T>
+inline void Write(Sink& sink, T value)
+{
+    WriteDec(sink, value, 0, ' ', 0);
+}
+template<typename Sink, typename T, uint8_t Width, char Fill, uint8_t FracDigits>
+inline void Write(Sink& sink, DecFormat<T, Width, Fill, FracDigits> f)
+{
+    WriteDec(sink, f.value, Width, Fill, FracDigits);
+}
+template<typename Sink, typename T, uint8_t Width, char Fill>
+inline void Write(Sink& sink, HexFormat<T, Width, Fill> f)
+{
+    PutHex<Sink, typename stdx::make_unsigned<T>::type>(sink, f.value, Width, Fill);
+}
+
+// ---=== Format string ===---
+
+// Placeholders count and brace check over the characters of the format string
+template<char... Cs>
+struct FormatCheck;
+template<>
+struct FormatCheck<>
+{
+    enum
+    {
+        placeholders = 0,
+        valid = 1
+    };
+};
+template<char C, char... Cs>
+struct FormatCheck<C, Cs...> : FormatCheck<Cs...>
+{
+};
+template<char... Cs>
+struct FormatCheck<'\0', Cs...> : FormatCheck<>
+{
+};
+template<char... Cs>
+struct FormatCheck<'{', '}', Cs...>
+{
+    enum
+    {
+        placeholders = FormatCheck<Cs...>::placeholders + 1,
+        valid = FormatCheck<Cs...>::valid
+    };
+};
+template<char C, char... Cs>
+struct FormatCheck<'{', C, Cs...>
+{
+    enum
+    {
+        placeholders = 0,
+        valid = 0
+    };
+};
+template<>
+struct FormatCheck<'{'> : FormatCheck<'{', '\0'>
+{
+};
+template<char... Cs>
+struct FormatCheck<'}', Cs...> : FormatCheck<'{', '\0'>
+{
+};
+
+template<typename Check, size_t Length>
+inline Format<Check::placeholders> MakeFormat(const char* str)
+{
+    static_assert(Length <= FormatMaxLength + 1, "Format string is too long");
+    static_assert(Check::valid, "Braces in format string must form {} placeholders");
+    Format<Check::placeholders> f = { str };
+    return f;
+}
+
+// Writes the text up to the next placeholder, returns the text after it
+template<typename Sink>
+const char* WriteText(Sink& sink, const char* s)
+{
+    while(*s && *s != '{') {
+        sink.Putch(*s++);
+    }
+    return *s ? s + 2 : s;
+}
+template<typename Sink>
+inline void WriteFormat(Sink& sink, const char* s)
+{
+    Write(sink, s);
+}
+template<typename Sink, typename T, typename... Rest>
+void WriteFormat(Sink& sink, const char* s, const T& first, const Rest&... rest)
+{
+    s = WriteText(sink, s);
+    Write(sink, first);
+    WriteFormat(sink, s, rest...);
+}
+
+} // Internal
+
+template<typename Sink, typename... Args>
+void Print(Sink& sink, const Args&... args)
+{
+    const int dummy[] = { 0, (Internal::Write(sink, args), 0)... };
+    (void)dummy;
+}
+// For sinks with static Putch
+template<typename Sink, typename... Args>
+void Print(const Args&... args)
+{
+    Sink sink;
+    Print(sink, args...);
+}
+
+template<typename Sink, uint8_t Placeholders, typename... Args>
+void PrintF(Sink& sink, Format<Placeholders> fmt, const Args&... args)
+{
+    static_assert(Placeholders == sizeof...(Args), "Number of {} placeholders doesn't match the arguments");
+    Internal::WriteFormat(sink, fmt.str, args...);
+}
+// For sinks with static Putch
+template<typename Sink, uint8_t Placeholders, typename... Args>
+void PrintF(Format<Placeholders> fmt, const Args&... args)
+{
+    Sink sink;
+    PrintF(sink, fmt, args...);
+}
+
+} // io
+
+// Format string literal checked at compile time, up to io::FormatMaxLength characters
+#define IO_FMT(s) (::io::Internal::MakeFormat< ::io::Internal::FormatCheck<IO_FMT_CHARS(s)>, sizeof(s)>(s))
+#define IO_FMT_CH(s, i) ((i) < sizeof(s) ? (s)[(i) < sizeof(s) ? (i) : 0] : '\0')
+#define IO_FMT_CH4(s, i) IO_FMT_CH(s, i), IO_FMT_CH(s, i + 1), IO_FMT_CH(s, i + 2), IO_FMT_CH(s, i + 3)
+#define IO_FMT_CH16(s, i) IO_FMT_CH4(s, i), IO_FMT_CH4(s, i + 4), IO_FMT_CH4(s, i + 8), IO_FMT_CH4(s, i + 12)
+#define IO_FMT_CHARS(s) IO_FMT_CH16(s, 0), IO_FMT_CH16(s, 16), IO_FMT_CH16(s, 32), IO_FMT_CH16(s, 48)
+
+#endif // FORMAT_H
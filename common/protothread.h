@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+#ifndef PROTOTHREAD_H
+#define PROTOTHREAD_H
+
+#include <stdint.h>
+
+// Stackless cooperative tasks (protothreads). The task function resumes at the last wait point
+// by a switch on the saved line number, so local variables don't survive a wait: keep the state
+// in static members. switch statements can't enclose wait points.
+//
+//  struct Blink
+//  {
+//      static Tasks::Pt pt;
+//      static Tasks::Timeout<Wk::SysTimers> tmo;
+//      static uint8_t Run()
+//      {
+//          PT_BEGIN(pt);
+//          while(true) {
+//              Led::Toggle();
+//              PT_DELAY(pt, tmo, Wk::SysTickFreq / 2);
+//          }
+//          PT_END(pt);
+//      }
+//  };
+//  Tasks::Scheduler<Blink, Sensor, Console>::Run();
+//
+// Non-blocking variants of the driver wait points: Uart::TryPutch/TryGetch, SysClock::StartSelect/IsSelectDone,
+// OneWire::ResetPulse (the 410 us bus recovery is left to the task).
+// Wait points that stay blocking:
+//  - OneWire bit slots (70 us) and the reset pulse (550 us): the bus timing doesn't allow
+//    a tick (~16 ms) in between, and interrupts are disabled for parts of the slot anyway.
+//  - SoftTwi bit delays (a few us per half bit): the clock line is driven by software,
+//    a transfer is a few hundred us at most.
+//  - Bootloader::Transmit: the bootloader runs alone before the application, there is no task to yield to.
+
+#define PT_BEGIN(pt)                            \
+    {                                           \
+        switch((pt).lc) {                       \
+        case 0:
+#define PT_END(pt)                              \
+        }                                       \
+        (pt).lc = 0;                            \
+        return Mcudrv::Tasks::PtEnded;          \
+    }
+// Returns control to the scheduler until cond is true
+#define PT_WAIT_UNTIL(pt, cond)                 \
+    do {                                        \
+        (pt).lc = __LINE__;                     \
+        case __LINE__:                          \
+        if(!(cond)) {                           \
+            return Mcudrv::Tasks::PtWaiting;    \
+        }                                       \
+    } while(0)
+#define PT_WAIT_WHILE(pt, cond) PT_WAIT_UNTIL(pt, !(cond))
+// Returns control once, other tasks run in between
+#define PT_YIELD(pt)                            \
+    do {                                        \
+        (pt).lc = __LINE__;                     \
+        return Mcudrv::Tasks::PtYielded;        \
+        case __LINE__:;                         \
+    } while(0)
+// Runs a child task (uint8_t function returning Pt state) until it ends
+#define PT_SPAWN(pt, child) PT_WAIT_UNTIL(pt, (child) >= Mcudrv::Tasks::PtExited)
+#define PT_RESTART(pt)                          \
+    do {                                        \
+        (pt).lc = 0;                            \
+        return Mcudrv::Tasks::PtWaiting;        \
+    } while(0)
+#define PT_EXIT(pt)                             \
+    do {                                        \
+        (pt).lc = 0;                            \
+        return Mcudrv::Tasks::PtExited;         \
+    } while(0)
+// Non-blocking replacement for delay_ms(), ticks of the timeout's clock
+#define PT_DELAY(pt, timeout, ticks)            \
+    do {                                        \
+        (timeout).Start(ticks);                 \
+        PT_WAIT_UNTIL(pt, (timeout).IsExpired());\
+    } while(0)
+
+namespace Mcudrv {
+namespace Tasks {
+enum PtState
+{
+    PtWaiting,
+    PtYielded,
+    PtExited,
+    PtEnded
+};
+
+// Continuation of the task: line number of the last wait point
+struct Pt
+{
+    uint16_t lc;
+    Pt() : lc(0)
+    { }
+    void Reset()
+    {
+        lc = 0;
+    }
+};
+
+// Timeout on a free running tick counter, Clock::Now() returns uint16_t ticks (SoftTimers::TimerWheel)
+template<typename Clock>
+class Timeout
+{
+private:
+    uint16_t start_;
+    uint16_t ticks_;
+public:
+    void Start(uint16_t ticks)
+    {
+        start_ = Clock::Now();
+        ticks_ = ticks;
+    }
+    bool IsExpired() const
+    {
+        return uint16_t(Clock::Now() - start_) >= ticks_;
+    }
+};
+
+// Static task list, Task::Run() is a protothread returning PtState.
+// Ended and exited tasks are restarted on the next pass.
+template<typename... Tasks>
+struct Scheduler;
+template<>
+struct Scheduler<>
+{
+    static void RunOnce()
+    { }
+};
+template<typename Task, typename... Tasks>
+struct Scheduler<Task, Tasks...>
+{
+    // One pass over all tasks, e.g. from a main loop doing something else
+    static void RunOnce()
+    {
+        Task::Run();
+        Scheduler<Tasks...>::RunOnce();
+    }
+    static void Run()
+    {
+        while(true) {
+            RunOnce();
+        }
+    }
+};
+
+} // Tasks
+} // Mcudrv
+
+#endif // PROTOTHREAD_H
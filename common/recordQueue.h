@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+#include "circularBuffer.h"
+
+// Queue of variable length records on top of the byte CircularBuffer.
+// Every record is stored contiguously, prefixed by its total size (header included),
+// so it can be filled and consumed in place. When a record doesn't fit in the tail of the buffer,
+// the tail is marked as padding (zero header or a tail shorter than the header) and the record
+// starts from the beginning of the buffer.
+//
+// Producer: Reserve(len) -> fill -> Commit(len) (or Push). Consumer: Peek(len) -> use -> Release().
+// Records filled or used in place are ordered against the buffer indexes by compiler barriers in
+// Commit and Peek.
+// With DropOldest a Reserve that finds no room asks the consumer to drop the oldest record: each side
+// keeps to its own index, the request is served by the next Peek. The record that didn't fit is lost.
+template<size_t SIZE, bool DropOldest = false>
+class RecordQueue
+{
+public:
+    typedef CircularBuffer<SIZE, uint8_t> Buffer;
+    typedef typename Buffer::INDEX_T INDEX_T;
+    enum
+    {
+        HeaderSize = sizeof(INDEX_T),
+        MaxRecordSize = SIZE / 2 - HeaderSize // always fits in empty queue
+    };
+private:
+    Buffer buf_;
+    uint8_t* reserved_;
+    volatile uint8_t dropRequests_; // producer side counter
+    uint8_t dropsDone_;             // consumer side counter
+
+    static INDEX_T ReadHeader(const uint8_t* ptr)
+    {
+        INDEX_T header;
+        CircularBufferData::Copy(&header, reinterpret_cast<const INDEX_T*>(ptr), 1);
+        return header;
+    }
+    static void WriteHeader(uint8_t* ptr, INDEX_T header)
+    {
+        CircularBufferData::Copy(reinterpret_cast<INDEX_T*>(ptr), &header, 1);
+    }
+    // Consumer side: skips padding, returns the oldest record (header included) or 0 if empty
+    const uint8_t* Front()
+    {
+        const uint8_t* ptr;
+        for(;;) {
+            INDEX_T span = buf_.GetReadSpan(ptr);
+            if(!span)
+                return 0;
+            if(span >= HeaderSize && ReadHeader(ptr))
+                return ptr;
+            buf_.ConsumeRead(span);
+        }
+    }
+    // Consumer side: serves the drop requests of the producer
+    void DropRequested()
+    {
+        const uint8_t requests = dropRequests_;
+        while(dropsDone_ != requests) {
+            ++dropsDone_;
+            const uint8_t* ptr = Front();
+            if(!ptr) {
+                dropsDone_ = requests;
+                break;
+            }
+            buf_.ConsumeRead(ReadHeader(ptr));
+        }
+    }
+public:
+    // Returns pointer to len bytes of contiguous space or 0 if there is no room
+    uint8_t* Reserve(INDEX_T len)
+    {
+        if(len > MaxRecordSize)
+            return 0;
+        const INDEX_T need = len + HeaderSize;
+        for(;;) {
+            uint8_t* ptr;
+            INDEX_T span = buf_.GetWriteSpan(ptr);
+            if(span >= need) {
+                reserved_ = ptr;
+                return ptr + HeaderSize;
+            }
+            INDEX_T free = (INDEX_T)(SIZE - buf_.Count());
+            if((INDEX_T)(free - span) >= need) { // span is limited by the end of the buffer, wrap around
+                if(span >= HeaderSize)
+                    WriteHeader(ptr, 0);
+                buf_.CommitWrite(span);
+            }
+            else {
+                if(DropOldest)
+                    dropRequests_ = dropRequests_ + 1;
+                return 0;
+            }
+        }
+    }
+    // Publishes the reserved record, len may be less than reserved
+    void Commit(INDEX_T len)
+    {
+        CircularBufferData::Barrier(); // the record is filled before it's published
+        WriteHeader(reserved_, len + HeaderSize);
+        buf_.CommitWrite(len + HeaderSize);
+    }
+    bool Push(const uint8_t* data, INDEX_T len)
+    {
+        uint8_t* ptr = Reserve(len);
+        if(!ptr)
+            return false;
+        CircularBufferData::CopyBulk(ptr, data, len);
+        Commit(len);
+        return true;
+    }
+
+    // Returns pointer to the oldest record and its length, or 0 if the queue is empty
+    const uint8_t* Peek(INDEX_T& len)
+    {
+        if(DropOldest)
+            DropRequested();
+        const uint8_t* ptr = Front();
+        if(!ptr)
+            return 0;
+        len = ReadHeader(ptr) - HeaderSize;
+        CircularBufferData::Barrier(); // the record isn't read before the index
+        return ptr + HeaderSize;
+    }
+    // Removes the record returned by Peek
+    void Release()
+    {
+        const uint8_t* ptr;
+        if(buf_.GetReadSpan(ptr))
+            buf_.ConsumeRead(ReadHeader(ptr));
+    }
+};
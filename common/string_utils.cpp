@@ -4,7 +4,7 @@
 namespace io {
 uint8_t* InsertDot(uint16_t value, uint8_t position, uint8_t* buf)
 {
-    size_t len = strlen((const char*)utoa16(value, buf));
+    size_t len = utoa16(value, buf) - buf;
     if(len <= position) {
         const uint8_t offset = position + 2 - len;
         memmove(buf + offset, buf, len + 1);
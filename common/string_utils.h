@@ -2,11 +2,74 @@
 #ifndef STRING_UTILS_H
 #define STRING_UTILS_H
 
+#include "format.h"
 #include "type_traits.h"
 
 namespace io {
+namespace Internal {
+// Quotient by 10 as a multiplication by the reciprocal: 0.8 = 0.110011001100...b by shifts and adds,
+// divided by 8, then corrected by the remainder. No multiplier is needed (STM8 MUL is 8x8 bit) and the
+// shifts by 8 and 16 are byte and word moves, 32-bit division would be a library call.
+inline uint16_t Div10(uint16_t n)
+{
+    uint16_t q = (n >> 1) + (n >> 2);
+    q += q >> 4;
+    q += q >> 8;
+    q >>= 3;
+    const uint16_t r = n - ((q << 2) + q) * 2;
+    return q + (r > 9);
+}
+inline uint8_t Div10(uint8_t n)
+{
+    return uint8_t(Div10(uint16_t(n)));
+}
+inline uint32_t Div10(uint32_t n)
+{
+    uint32_t q = (n >> 1) + (n >> 2);
+    q += q >> 4;
+    q += q >> 8;
+    q += q >> 16;
+    q >>= 3;
+    const uint32_t r = n - ((q << 2) + q) * 2;
+    return q + (r > 9);
+}
+template<typename UT>
+inline UT Div10(UT n)
+{
+    return n / 10;
+}
+} // Internal
+
+// Decimal conversion, returns pointer to the terminating null character.
+// The digits are counted against the powers of ten and written in place from the last one.
+template<typename T>
+uint8_t* xtoa(T value, uint8_t* result)
+{
+    typedef typename Internal::UnsignedOfSize<sizeof(T)>::type UT;
+    typedef Pow10<UT> Pow;
+    const bool negative = stdx::is_negative(value);
+    UT quotient = negative ? UT(UT(0) - UT(value)) : UT(value);
+    uint8_t digits = Pow::count;
+    for(uint8_t i = 0; digits > 1 && quotient < Pow::table[i]; ++i) {
+        --digits;
+    }
+    if(negative) {
+        *result++ = '-';
+    }
+    uint8_t* const end = result + digits;
+    uint8_t* out = end;
+    *out = '\0';
+    do {
+        const UT q = Internal::Div10(quotient);
+        *--out = uint8_t('0' + uint8_t(uint8_t(quotient) - uint8_t(q) * 10)); // remainder fits in a byte
+        quotient = q;
+    } while(quotient);
+    return end;
+}
+
+// Conversion in any base up to 36, returns pointer to the terminating null character
 template<typename T>
-uint8_t* xtoa(T value, uint8_t* result, uint8_t base = 10)
+uint8_t* xtoa(T value, uint8_t* result, uint8_t base)
 {
     typedef typename stdx::make_unsigned<T>::type UT;
     uint8_t* out = result;
@@ -39,47 +102,91 @@ uint8_t* xtoa(T value, uint8_t* result, uint8_t base = 10)
 
 #pragma inline = forced
 template<typename T>
-inline static uint8_t* utoa(T value, uint8_t* result, uint8_t base = 10)
+inline static uint8_t* utoa(T value, uint8_t* result)
+{
+    static_assert(!stdx::is_signed<T>::value, "utoa called with signed arg");
+    return xtoa(value, result);
+}
+#pragma inline = forced
+template<typename T>
+inline static uint8_t* utoa(T value, uint8_t* result, uint8_t base)
 {
     static_assert(!stdx::is_signed<T>::value, "utoa called with signed arg");
     return xtoa(value, result, base);
 }
 #pragma inline = forced
 template<typename T>
-inline static uint8_t* itoa(T value, uint8_t* result, uint8_t base = 10)
+inline static uint8_t* itoa(T value, uint8_t* result)
+{
+    static_assert(stdx::is_signed<T>::value, "itoa called with unsigned arg");
+    return xtoa(value, result);
+}
+#pragma inline = forced
+template<typename T>
+inline static uint8_t* itoa(T value, uint8_t* result, uint8_t base)
 {
     static_assert(stdx::is_signed<T>::value, "itoa called with unsigned arg");
     return xtoa(value, result, base);
 }
 
 #pragma inline = forced
-inline static uint8_t* utoa8(uint8_t value, uint8_t* result, uint8_t base = 10)
+inline static uint8_t* utoa8(uint8_t value, uint8_t* result)
+{
+    return utoa(value, result);
+}
+#pragma inline = forced
+inline static uint8_t* utoa8(uint8_t value, uint8_t* result, uint8_t base)
 {
     return utoa(value, result, base);
 }
 #pragma inline = forced
-inline static uint8_t* utoa16(uint16_t value, uint8_t* result, uint8_t base = 10)
+inline static uint8_t* utoa16(uint16_t value, uint8_t* result)
+{
+    return utoa(value, result);
+}
+#pragma inline = forced
+inline static uint8_t* utoa16(uint16_t value, uint8_t* result, uint8_t base)
 {
     return utoa(value, result, base);
 }
 #pragma inline = forced
-inline static uint8_t* utoa32(uint32_t value, uint8_t* result, uint8_t base = 10)
+inline static uint8_t* utoa32(uint32_t value, uint8_t* result)
+{
+    return utoa(value, result);
+}
+#pragma inline = forced
+inline static uint8_t* utoa32(uint32_t value, uint8_t* result, uint8_t base)
 {
     return utoa(value, result, base);
 }
 
 #pragma inline = forced
-inline static uint8_t* itoa8(int8_t value, uint8_t* result, uint8_t base = 10)
+inline static uint8_t* itoa8(int8_t value, uint8_t* result)
+{
+    return itoa(value, result);
+}
+#pragma inline = forced
+inline static uint8_t* itoa8(int8_t value, uint8_t* result, uint8_t base)
 {
     return itoa(value, result, base);
 }
 #pragma inline = forced
-inline static uint8_t* itoa16(int16_t value, uint8_t* result, uint8_t base = 10)
+inline static uint8_t* itoa16(int16_t value, uint8_t* result)
+{
+    return itoa(value, result);
+}
+#pragma inline = forced
+inline static uint8_t* itoa16(int16_t value, uint8_t* result, uint8_t base)
 {
     return itoa(value, result, base);
 }
 #pragma inline = forced
-inline static uint8_t* itoa32(int32_t value, uint8_t* result, uint8_t base = 10)
+inline static uint8_t* itoa32(int32_t value, uint8_t* result)
+{
+    return itoa(value, result);
+}
+#pragma inline = forced
+inline static uint8_t* itoa32(int32_t value, uint8_t* result, uint8_t base)
 {
     return itoa(value, result, base);
 }
@@ -91,25 +91,42 @@ struct TypeMaxvalue<uint32_t>
     static const uint32_t value = UINT32_MAX;
 };
 
+// Specialized for built-in types rather than intN_t typedefs, so every integer type is covered
+// whichever of them the typedefs map to (int32_t is long on STM8, int on a 64-bit host).
 template<typename T>
 struct make_unsigned
 {
     typedef T type;
 };
 template<>
-struct make_unsigned<int32_t>
+struct make_unsigned<char>
 {
-    typedef uint32_t type;
+    typedef unsigned char type;
 };
 template<>
-struct make_unsigned<int16_t>
+struct make_unsigned<signed char>
 {
-    typedef uint16_t type;
+    typedef unsigned char type;
 };
 template<>
-struct make_unsigned<int8_t>
+struct make_unsigned<short>
 {
-    typedef uint8_t type;
+    typedef unsigned short type;
+};
+template<>
+struct make_unsigned<int>
+{
+    typedef unsigned int type;
+};
+template<>
+struct make_unsigned<long>
+{
+    typedef unsigned long type;
+};
+template<>
+struct make_unsigned<long long>
+{
+    typedef unsigned long long type;
 };
 
 template<typename T>
@@ -118,17 +135,32 @@ struct is_signed
     static const bool value = false;
 };
 template<>
-struct is_signed<int8_t>
+struct is_signed<char>
+{
+    static const bool value = char(-1) < char(0);
+};
+template<>
+struct is_signed<signed char>
+{
+    static const bool value = true;
+};
+template<>
+struct is_signed<short>
+{
+    static const bool value = true;
+};
+template<>
+struct is_signed<int>
 {
     static const bool value = true;
 };
 template<>
-struct is_signed<int16_t>
+struct is_signed<long>
 {
     static const bool value = true;
 };
 template<>
-struct is_signed<int32_t>
+struct is_signed<long long>
 {
     static const bool value = true;
 };
@@ -213,4 +245,35 @@ struct MaskToPosition<0x00>
         value = 0
     };
 };
+// Compile-time index sequence, used to expand lookup tables
+// MakeIndexList<4>::type == IndexList<0, 1, 2, 3>
+template<unsigned... I>
+struct IndexList
+{
+};
+
+template<typename L, typename R>
+struct ConcatIndexList;
+template<unsigned... L, unsigned... R>
+struct ConcatIndexList<IndexList<L...>, IndexList<R...> >
+{
+    typedef IndexList<L..., (sizeof...(L) + R)...> type;
+};
+
+template<unsigned N>
+struct MakeIndexList
+{
+    typedef typename ConcatIndexList<typename MakeIndexList<N / 2>::type,
+                                     typename MakeIndexList<N - N / 2>::type>::type type;
+};
+template<>
+struct MakeIndexList<0>
+{
+    typedef IndexList<> type;
+};
+template<>
+struct MakeIndexList<1>
+{
+    typedef IndexList<0> type;
+};
 }
@@ -23,6 +23,7 @@
 #pragma once
 
 #include "adc.h"
+#include "adc_scan.h"
 
 namespace Mcudrv {
 namespace AdcKeys {
@@ -69,6 +70,45 @@ struct KeyboardTraits
 
 typedef KeyboardTraits<0xFF, 10000UL, 2400UL, 3300UL, 4300UL, 5100UL, 8200UL, 16000UL, 56000UL> DefaultCfg;
 
+namespace Internal {
+// Key of the sample, repeated SampleCount times to be reported
+template<typename Handler, typename Traits>
+struct KeyDecoder
+{
+#pragma inline = forced
+    static void Process(uint8_t sample)
+    {
+        static uint8_t scount;
+        static uint8_t prev_key;
+        uint8_t key;
+        if(sample > Traits::B1value_min && sample < Traits::B1value_max)
+            key = 0;
+        if(sample > Traits::B2value_min && sample < Traits::B2value_max)
+            key = 1;
+        if(sample > Traits::B3value_min && sample < Traits::B3value_max)
+            key = 2;
+        if(sample > Traits::B4value_min && sample < Traits::B4value_max)
+            key = 3;
+        if(sample > Traits::B5value_min && sample < Traits::B5value_max)
+            key = 4;
+        if(sample > Traits::B6value_min && sample < Traits::B6value_max)
+            key = 5;
+        if(sample > Traits::B7value_min && sample < Traits::B7value_max)
+            key = 6;
+        if(key == prev_key) {
+            if(scount != Traits::SampleCount)
+                scount++;
+        }
+        else {
+            prev_key = key;
+            scount = 0;
+        }
+        if(scount == Traits::SampleCount - 1)
+            Handler::KeyboardHandler(key);
+    }
+};
+} // Internal
+
 template<typename Handler, typename Traits = DefaultCfg>
 struct Buttons : Adcs::Adc<Mode8Bit>
 {
@@ -87,41 +127,31 @@ private:
     //			static callback_t cb_;
     _Pragma(VECTOR_ID(ADC1_AWDG_vector)) __interrupt static void AnalogWatchdogISR()
     {
-        static uint8_t scount;
         if(IsEvent<AnalogWatchdog>()) {
             ClearEvent<AnalogWatchdog>();
-            static uint8_t prev_key;
-            uint8_t key;
-            uint8_t sample = Buttons::ReadSample();
-            if(sample > Traits::B1value_min && sample < Traits::B1value_max)
-                key = 0;
-            if(sample > Traits::B2value_min && sample < Traits::B2value_max)
-                key = 1;
-            if(sample > Traits::B3value_min && sample < Traits::B3value_max)
-                key = 2;
-            if(sample > Traits::B4value_min && sample < Traits::B4value_max)
-                key = 3;
-            if(sample > Traits::B5value_min && sample < Traits::B5value_max)
-                key = 4;
-            if(sample > Traits::B6value_min && sample < Traits::B6value_max)
-                key = 5;
-            if(sample > Traits::B7value_min && sample < Traits::B7value_max)
-                key = 6;
-            if(key == prev_key) {
-                if(scount != Traits::SampleCount)
-                    scount++;
-            }
-            else {
-                prev_key = key;
-                scount = 0;
-            }
-            if(scount == Traits::SampleCount - 1)
-                Handler::KeyboardHandler(key);
+            Internal::KeyDecoder<Handler, Traits>::Process(Buttons::ReadSample());
             // cb_(key);
         }
     }
 };
 
+// Keys on a channel of Adcs::ScanEngine or BurstEngine, which owns the ADC interrupt. Process is called from the
+// main loop and decodes every new set of samples.
+template<typename Handler, typename Engine, Channel ch, typename Traits = DefaultCfg>
+struct ScanButtons
+{
+    static void Process()
+    {
+        static uint8_t seq;
+        if(seq == Engine::GetSequence())
+            return;
+        seq = Engine::GetSequence();
+        const uint8_t sample = Engine::template GetAverage<ch>() >> 2; // 10 -> 8 bit
+        if(sample < Traits::WatchdogThreshold) // the analog watchdog threshold of Buttons
+            Internal::KeyDecoder<Handler, Traits>::Process(sample);
+    }
+};
+
 //		template<typename Traits>
 //		callback_t Buttons<Traits>::cb_;
 
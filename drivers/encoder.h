@@ -25,6 +25,8 @@
 #define ENCODER_H
 
 #include "gpio.h"
+#include "pinlist.h"
+#include "timers.h"
 
 namespace Mcudrv {
 namespace Encoders {
@@ -236,6 +238,90 @@ public:
     }
 };
 
+// ---=== TIM1 quadrature encoder interface ===---
+
+// Counting is done by TIM1 in encoder mode 3 (both edges of both inputs), so no steps are missed
+// regardless of the rotation speed and the main loop load. The inputs are TIM1 CH1 and CH2 pins:
+// STM8S103/003 - PC6, PC7 with AFR0 remap set in option byte OPT2 (PC5 becomes TIM2_CH1 as well),
+// STM8S903 - PC6, PC7 with AFR0 remap set in OPT2 (PC5 becomes TIM5_CH1 as well),
+// other devices - PC1, PC2, no remap.
+// CountsPerStep - timer counts per detent (4 for a full quadrature cycle per detent).
+template<uint8_t CountsPerStep = 4, T1::ChannelCfgIn filter = T1::In_Filt_div4_n8>
+class Tim1Encoder
+{
+private:
+#if defined(STM8S103) || defined(STM8S003) || defined(STM8S903)
+    typedef Pinlist<Pc6, Pc7> Pins; // AFR0: PC6 - TIM1_CH1, PC7 - TIM1_CH2
+#else
+    typedef Pinlist<Pc1, Pc2> Pins;
+#endif
+    static uint16_t last_;          // count of the last reported step
+    static uint16_t lastSample_;    // count at the last Sample()
+    static volatile int16_t delta_; // counts per sample period
+public:
+    static void InitGpio()
+    {
+        Pins::template SetConfig<GpioBase::In_Pullup>();
+    }
+    static void Init()
+    {
+        using namespace T1;
+        InitGpio();
+        Timer1::Init(1);
+        Timer1::SetChannelCfg<Ch1, Input, filter>();
+        Timer1::SetChannelCfg<Ch2, Input, filter>();
+        Timer1::SetSlaveMode(EncoderMode3);
+        Timer1::WriteAutoReload(0xFFFF);
+        Timer1::Enable();
+        last_ = lastSample_ = Timer1::ReadCounter();
+    }
+    // Raw position in timer counts, wraps around
+    static uint16_t GetCount()
+    {
+        return T1::Timer1::ReadCounter();
+    }
+    // Same as Encoder::IsChanged, all the steps made since the last call are applied
+    template<typename T>
+    static bool IsChanged(T& value)
+    {
+        int16_t steps = int16_t(GetCount() - last_) / CountsPerStep;
+        if(!steps) {
+            return false;
+        }
+        last_ += steps * CountsPerStep;
+        for(; steps > 0; --steps) {
+            ++value;
+        }
+        for(; steps < 0; ++steps) {
+            --value;
+        }
+        return true;
+    }
+    // Has to be called at a fixed rate (e.g. from a periodic timer) for the velocity estimation
+    static void Sample()
+    {
+        const uint16_t count = GetCount();
+        delta_ = int16_t(count - lastSample_);
+        lastSample_ = count;
+    }
+    // Steps per second, sampleFreq - Sample() call rate in Hz, the sign is the direction
+    static int16_t GetVelocity(const uint16_t sampleFreq)
+    {
+        __istate_t state = __get_interrupt_state();
+        __disable_interrupt(); // Sample() may run in an ISR, the byte halves could be torn
+        const int16_t delta = delta_;
+        __set_interrupt_state(state);
+        return int32_t(delta) * sampleFreq / CountsPerStep;
+    }
+};
+
+template<uint8_t CountsPerStep, T1::ChannelCfgIn filter>
+uint16_t Tim1Encoder<CountsPerStep, filter>::last_;
+template<uint8_t CountsPerStep, T1::ChannelCfgIn filter>
+uint16_t Tim1Encoder<CountsPerStep, filter>::lastSample_;
+template<uint8_t CountsPerStep, T1::ChannelCfgIn filter>
+volatile int16_t Tim1Encoder<CountsPerStep, filter>::delta_;
+
 } // Encoder
 } // Mcudrv
 
@@ -25,6 +25,15 @@ public:
         P_512ms,
         P_1s
     };
+    // Timeout of a period in ms, LSI 128 kHz and the reset value of the reload register
+    template<Period p>
+    struct Timeout
+    {
+        enum
+        {
+            ms = 16U << p
+        };
+    };
 
     static void Refresh()
     {
@@ -178,8 +178,8 @@ public:
     static void Init()
     {
         ADC1->CR1 = static_cast<uint8_t>(cfg) | (div << 4UL);
-        ADC1->CR2 = cfg >> 8UL | ((mode == Mode10bit) ? ADC1_CR2_ALIGN : 0UL);
-        ADC1->CR3 = cfg >> 16UL;
+        ADC1->CR2 = ((cfg >> 8UL) & 0xFF) | ((mode == Mode10bit) ? ADC1_CR2_ALIGN : 0UL);
+        ADC1->CR3 = (cfg >> 16UL) & 0xFF;
     }
 
     static void EnableInterrupt(Ints mask)
@@ -0,0 +1,320 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+#ifndef ADC_SCAN_H
+#define ADC_SCAN_H
+
+#include "adc.h"
+#include "delay.h"
+
+namespace Mcudrv {
+namespace Adcs {
+namespace Internal {
+template<Channel... Channels>
+struct ChannelList;
+template<>
+struct ChannelList<>
+{
+    enum
+    {
+        count = 0,
+        last = 0,
+        mask = 0
+    };
+    template<Channel>
+    struct IndexOf
+    {
+        enum
+        {
+            value = 0
+        };
+    };
+    FORCEINLINE
+    static void Accumulate(uint16_t*, const uint16_t*)
+    { }
+};
+template<Channel Head, Channel... Tail>
+struct ChannelList<Head, Tail...>
+{
+    typedef ChannelList<Tail...> Next;
+    enum
+    {
+        count = 1 + Next::count,
+        last = int(Head) > int(Next::last) ? int(Head) : int(Next::last),
+        mask = 1U << Head | Next::mask
+    };
+    // count if not in the list
+    template<Channel ch>
+    struct IndexOf
+    {
+        enum
+        {
+            value = ch == Head ? 0 : 1 + Next::template IndexOf<ch>::value
+        };
+    };
+    FORCEINLINE
+    static void Accumulate(uint16_t* sums, const uint16_t* buffer)
+    {
+        *sums += buffer[Head];
+        Next::Accumulate(sums + 1, buffer);
+    }
+};
+
+// Two banks of channel sums: the EOC interrupt fills one while the other is read, so a reader always
+// gets a complete set without locking. Owner keeps the statics of every engine apart.
+template<typename Owner, typename List>
+class SumBanks
+{
+protected:
+    enum
+    {
+        ChannelCount = List::count
+    };
+    static_assert(ChannelCount > 0, "Channel list is empty");
+    static uint16_t sums_[2][ChannelCount];
+    static volatile uint8_t ready_; // bank of the last complete set
+    static volatile uint8_t seq_;
+    static volatile bool busy_;
+
+    // The bank being filled by the interrupt
+    static uint16_t* Filling()
+    {
+        return sums_[ready_ ^ 1];
+    }
+    static void Publish()
+    {
+        ready_ ^= 1;
+        ++seq_;
+        busy_ = false;
+    }
+public:
+    static bool IsBusy()
+    {
+        return busy_;
+    }
+    // Changes on every published set
+    static uint8_t GetSequence()
+    {
+        return seq_;
+    }
+    // Sum of the samples of the channel from the last complete set
+    template<Channel ch>
+    static uint16_t GetSum()
+    {
+        static_assert(int(List::template IndexOf<ch>::value) < int(ChannelCount), "Channel is not scanned");
+        return sums_[ready_][List::template IndexOf<ch>::value];
+    }
+    // All the sums of one set, in the order of Channels
+    static void Snapshot(uint16_t (&sums)[ChannelCount])
+    {
+        uint8_t seq;
+        do {
+            seq = seq_;
+            const uint16_t* const src = sums_[ready_];
+            for(uint8_t i = 0; i < ChannelCount; ++i) {
+                sums[i] = src[i];
+            }
+        } while(seq != seq_);
+    }
+};
+
+template<typename Owner, typename List>
+uint16_t SumBanks<Owner, List>::sums_[2][SumBanks<Owner, List>::ChannelCount];
+template<typename Owner, typename List>
+volatile uint8_t SumBanks<Owner, List>::ready_;
+template<typename Owner, typename List>
+volatile uint8_t SumBanks<Owner, List>::seq_;
+template<typename Owner, typename List>
+volatile bool SumBanks<Owner, List>::busy_;
+} // Internal
+
+// Scan of the listed channels with the data buffer, 10 bit mode. The ADC converts channels 0..max(Channels)
+// in one run, the EOC interrupt adds the buffered results of the listed channels only and restarts the scan
+// until 2^SampleShift scans are done. The sums are then published to one of two banks, so a reader always
+// gets a complete set without locking while the next burst is accumulated. The ADC is off between bursts.
+// Every scan costs an EOC interrupt and brings one sample of a channel, so keep SampleShift small and
+// average the published sets instead (see filters.h), SampleShift = 0 takes one interrupt per Start().
+// For more samples per interrupt see BurstEngine.
+// The engine owns the ADC1 interrupt (single vector for EOC and AWD), so it's the only ADC user.
+template<uint8_t SampleShift, Channel... Channels>
+class ScanEngine : public Internal::SumBanks<ScanEngine<SampleShift, Channels...>, Internal::ChannelList<Channels...> >
+{
+private:
+    typedef Internal::ChannelList<Channels...> List;
+    typedef Internal::SumBanks<ScanEngine, List> Banks;
+    enum
+    {
+        ChannelCount = List::count,
+        Samples = 1U << SampleShift
+    };
+    static_assert(SampleShift <= 6, "16 bit sums overflow");
+
+    static uint16_t acc_[ChannelCount];
+    static uint8_t scans_;
+
+public:
+    _Pragma(VECTOR_ID(ADC1_EOC_vector)) __interrupt static void EocISR()
+    {
+        Adc1::ClearEvent(EndOfConv);
+        List::Accumulate(acc_, Adc1::buffer);
+        if(++scans_ < Samples) {
+            Adc1::StartConversion();
+            return;
+        }
+        uint16_t* const sums = Banks::Filling();
+        for(uint8_t i = 0; i < ChannelCount; ++i) {
+            sums[i] = acc_[i];
+            acc_[i] = 0;
+        }
+        scans_ = 0;
+        Banks::Publish();
+        Adc1::Disable(); // powered down between bursts
+    }
+    enum
+    {
+        MaxSum = 0x3FFU << SampleShift,
+        StabilizationUs = 7 // tSTAB, power-up to the first conversion
+    };
+
+    template<Div div>
+    static void Init()
+    {
+        Adc1::DisableSchmittTrigger<List::mask>();
+        Adc1::SelectChannel(Channel(List::last));
+        Adc1::Init<Cfg(ScanMode | BufferEnable), div>();
+        Adc1::EnableInterrupt(EndOfConv);
+    }
+    // Starts a burst of 2^SampleShift scans if the previous one is done
+    static void Start()
+    {
+        if(Banks::busy_) {
+            return;
+        }
+        Banks::busy_ = true;
+        Adc1::Enable(); // wakes the ADC up
+        delay_us<StabilizationUs>();
+        Adc1::StartConversion();
+    }
+    template<Channel ch>
+    static uint16_t GetAverage()
+    {
+        return Banks::template GetSum<ch>() >> SampleShift;
+    }
+};
+
+template<uint8_t SampleShift, Channel... Channels>
+uint16_t ScanEngine<SampleShift, Channels...>::acc_[ScanEngine<SampleShift, Channels...>::ChannelCount];
+template<uint8_t SampleShift, Channel... Channels>
+uint8_t ScanEngine<SampleShift, Channels...>::scans_;
+
+// Buffered continuous conversion of the listed channels in turn, 10 bit mode. The ADC repeats
+// conversions of one channel until the data buffer is full, so every EOC interrupt brings 10 samples:
+// a burst takes one interrupt per channel and publishes the sums of 10 samples of each channel
+// (to the banks as ScanEngine does). Continuous conversions are stopped by powering the ADC down, so
+// switching to the next channel costs tSTAB in the interrupt. The ADC is off between bursts.
+// The engine owns the ADC1 interrupt as ScanEngine does.
+template<Channel... Channels>
+class BurstEngine : public Internal::SumBanks<BurstEngine<Channels...>, Internal::ChannelList<Channels...> >
+{
+private:
+    typedef Internal::ChannelList<Channels...> List;
+    typedef Internal::SumBanks<BurstEngine, List> Banks;
+    enum
+    {
+        ChannelCount = List::count,
+        BufferSize = 10
+    };
+    static uint8_t index_; // of the channel being converted
+
+    static Channel ChannelAt(uint8_t index)
+    {
+        static const Channel channels[ChannelCount] = { Channels... };
+        return channels[index];
+    }
+    static void Convert()
+    {
+        Adc1::Enable(); // wakes the ADC up
+        delay_us<StabilizationUs>();
+        Adc1::StartConversion();
+    }
+
+public:
+    enum
+    {
+        Samples = BufferSize,
+        MaxSum = 0x3FFU * BufferSize,
+        StabilizationUs = 7 // tSTAB, power-up to the first conversion
+    };
+    _Pragma(VECTOR_ID(ADC1_EOC_vector)) __interrupt static void EocISR()
+    {
+        Adc1::Disable(); // stops the conversions before the buffer is overwritten
+        Adc1::ClearEvent(EndOfConv);
+        uint16_t sum = 0;
+        for(uint8_t i = 0; i < BufferSize; ++i) {
+            sum += Adc1::buffer[i];
+        }
+        Banks::Filling()[index_] = sum;
+        if(++index_ == ChannelCount) {
+            index_ = 0;
+        }
+        Adc1::SelectChannel(ChannelAt(index_));
+        if(index_) {
+            Convert();
+        }
+        else {
+            Banks::Publish();
+        }
+    }
+
+    template<Div div>
+    static void Init()
+    {
+        Adc1::DisableSchmittTrigger<List::mask>();
+        Adc1::SelectChannel(ChannelAt(0));
+        Adc1::Init<Cfg(ContMode | BufferEnable), div>();
+        Adc1::EnableInterrupt(EndOfConv);
+    }
+    // Starts a burst of 10 conversions of each channel if the previous one is done
+    static void Start()
+    {
+        if(Banks::busy_) {
+            return;
+        }
+        Banks::busy_ = true;
+        Convert();
+    }
+    template<Channel ch>
+    static uint16_t GetAverage()
+    {
+        return Banks::template GetSum<ch>() / BufferSize;
+    }
+};
+
+template<Channel... Channels>
+uint8_t BurstEngine<Channels...>::index_;
+
+} // Adcs
+} // Mcudrv
+
+#endif // ADC_SCAN_H
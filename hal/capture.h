@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "stm8s.h"
+#include "timers.h"
+
+namespace Mcudrv {
+namespace Capture {
+namespace Internal {
+// Input capture setup of the timer namespace (T1 or T2/T3), the input filter is fMASTER, N = 8
+template<typename Timer>
+struct TimerTraits;
+template<>
+struct TimerTraits<T1::Timer1>
+{
+    typedef T1::Ints Ints;
+    static const Ints IrqUpdate = T1::IRQ_Update;
+    static const Ints IrqCh1 = T1::IRQ_Ch1;
+    template<Timers::Channel Ch, bool paired, Timers::CaptureEdge edge>
+    static void SetupChannel()
+    {
+        using namespace T1;
+        Timer1::EnableCapture<Ch, paired ? InputMap1 : InputMap0, In_Filt_n8, edge>();
+    }
+};
+template<uint16_t BaseAddr>
+struct TimerTraits<T2::Internal::Timer<BaseAddr> >
+{
+    typedef T2::Ints Ints;
+    static const Ints IrqUpdate = T2::IRQ_Update;
+    static const Ints IrqCh1 = T2::IRQ_Ch1;
+    template<Timers::Channel Ch, bool paired, Timers::CaptureEdge edge>
+    static void SetupChannel()
+    {
+        using namespace T2;
+        static_assert(Ch < Timers::Ch3, "Channel 3 of TIM2 has no paired channel");
+        T2::Internal::Timer<BaseAddr>::template EnableCapture<Ch, paired ? InputMap1 : InputMap0, In_Filt_n8, edge>();
+    }
+};
+} // Internal
+
+// Period and high time of a pulse train on a timer input, e.g. a fan tachometer.
+// Ch captures the rising edges and its paired channel (Ch1/Ch2, Ch3/Ch4) the falling edges of the
+// same input, so the signal goes to the pin of Ch and the paired channel can't be used otherwise.
+// The counter runs free up to 0xFFFF, its overflows extend the timestamps to 32 bits, so periods
+// longer than the counter range are measured as well. Results are averaged over 2^AvgShift periods
+// and reset to 0 when no rising edge comes for StallOverflows counter overflows, so periods up to
+// (StallOverflows - 1) * 0x10000 ticks are always measured.
+// The timer clock (prescaler, CEN) is set by the user, CaptureIRQ and UpdateIRQ have to be called
+// from the capture/compare and update vectors of the timer.
+template<typename Timer, Timers::Channel Ch = Timers::Ch1, uint8_t AvgShift = 2, uint8_t StallOverflows = 2>
+class PeriodMeter
+{
+private:
+    typedef Internal::TimerTraits<Timer> Traits;
+    typedef typename Traits::Ints Ints;
+    static const Timers::Channel FallCh = Timers::Channel(Ch ^ 1);
+    static const Ints UpdateIrq = Traits::IrqUpdate;
+    static const Ints RiseIrq = Ints(Traits::IrqCh1 << Ch);
+    static const Ints FallIrq = Ints(Traits::IrqCh1 << FallCh);
+    static_assert(AvgShift < 8, "Too many periods to average");
+
+    static uint16_t overflows_; // timestamp extension
+    static uint8_t idle_;       // overflows since the last rising edge
+    static uint8_t count_;      // periods in the sums
+    static bool started_;       // lastRise_ is valid
+    static uint32_t lastRise_;
+    static uint32_t high_;
+    static uint32_t periodSum_;
+    static uint32_t highSum_;
+    static volatile uint32_t period_;
+    static volatile uint32_t highTime_;
+
+    FORCEINLINE
+    static uint32_t Stamp(const uint16_t capture, const bool ovfPending)
+    {
+        // A pending overflow happened before the capture if the latter is in the lower half of the range
+        const uint16_t ext = overflows_ + (ovfPending && capture < 0x8000U);
+        return (uint32_t)ext << 16 | capture;
+    }
+    static void OnRise(const uint32_t stamp)
+    {
+        if(started_) {
+            periodSum_ += stamp - lastRise_;
+            highSum_ += high_;
+            if(++count_ == 1U << AvgShift) {
+                period_ = periodSum_ >> AvgShift;
+                highTime_ = highSum_ >> AvgShift;
+                periodSum_ = highSum_ = 0;
+                count_ = 0;
+            }
+        }
+        lastRise_ = stamp;
+        started_ = true;
+        idle_ = 0;
+    }
+    FORCEINLINE
+    static void OnFall(const uint32_t stamp)
+    {
+        if(started_) {
+            high_ = stamp - lastRise_;
+        }
+    }
+    FORCEINLINE
+    static uint32_t Read(volatile uint32_t& value)
+    {
+        __istate_t state = __get_interrupt_state();
+        __disable_interrupt();
+        const uint32_t result = value;
+        __set_interrupt_state(state);
+        return result;
+    }
+
+public:
+    static void Init()
+    {
+        Timer::WriteAutoReload(0xFFFF);
+        Traits::template SetupChannel<Ch, false, Timers::RisingEdge>();
+        Traits::template SetupChannel<FallCh, true, Timers::FallingEdge>();
+        Timer::ClearIntFlag(Ints(UpdateIrq | RiseIrq | FallIrq));
+        Timer::EnableInterrupt(Ints(UpdateIrq | RiseIrq | FallIrq));
+    }
+
+    // Both edges may be pending, the falling one belongs to the previous pulse if it's older
+    static void CaptureIRQ()
+    {
+        const bool ovfPending = Timer::CheckIntStatus(UpdateIrq);
+        const bool rise = Timer::CheckIntStatus(RiseIrq);
+        const bool fall = Timer::CheckIntStatus(FallIrq);
+        uint32_t riseStamp = 0, fallStamp = 0;
+        if(rise) {
+            riseStamp = Stamp(Timer::template ReadCapture<Ch>(), ovfPending);
+        }
+        if(fall) {
+            fallStamp = Stamp(Timer::template ReadCapture<FallCh>(), ovfPending);
+        }
+        if(rise && fall && (int32_t)(fallStamp - riseStamp) < 0) {
+            OnFall(fallStamp);
+            OnRise(riseStamp);
+        }
+        else {
+            if(rise) {
+                OnRise(riseStamp);
+            }
+            if(fall) {
+                OnFall(fallStamp);
+            }
+        }
+    }
+    // The update vector is served before the capture/compare one, so the captures pending with it
+    // are taken first: those latched before the wrap must not get the new overflow count.
+    static void UpdateIRQ()
+    {
+        if(Timer::CheckIntStatus(Ints(RiseIrq | FallIrq))) {
+            CaptureIRQ();
+        }
+        Timer::ClearIntFlag(UpdateIrq);
+        ++overflows_;
+        if(idle_ < StallOverflows && ++idle_ == StallOverflows) {
+            period_ = highTime_ = 0;
+            periodSum_ = highSum_ = 0;
+            count_ = 0;
+            started_ = false;
+        }
+    }
+
+    // Averaged period in timer ticks, 0 - no signal
+    static uint32_t GetPeriod()
+    {
+        return Read(period_);
+    }
+    // Averaged high time in timer ticks
+    static uint32_t GetHighTime()
+    {
+        return Read(highTime_);
+    }
+    // Pulses per minute at the given timer clock
+    static uint16_t GetRate(const uint32_t tickFreq)
+    {
+        const uint32_t period = GetPeriod();
+        return period ? tickFreq * 60 / period : 0;
+    }
+    // Duty cycle in percents
+    static uint8_t GetDuty()
+    {
+        __istate_t state = __get_interrupt_state();
+        __disable_interrupt();
+        const uint32_t period = period_;
+        const uint32_t high = highTime_;
+        __set_interrupt_state(state);
+        return period ? (high * 100 + period / 2) / period : 0;
+    }
+    static bool IsStalled()
+    {
+        return !GetPeriod();
+    }
+};
+
+template<typename Timer, Timers::Channel Ch, uint8_t AvgShift, uint8_t StallOverflows>
+uint16_t PeriodMeter<Timer, Ch, AvgShift, StallOverflows>::overflows_;
+template<typename Timer, Timers::Channel Ch, uint8_t AvgShift, uint8_t StallOverflows>
+uint8_t PeriodMeter<Timer, Ch, AvgShift, StallOverflows>::idle_;
+template<typename Timer, Timers::Channel Ch, uint8_t AvgShift, uint8_t StallOverflows>
+uint8_t PeriodMeter<Timer, Ch, AvgShift, StallOverflows>::count_;
+template<typename Timer, Timers::Channel Ch, uint8_t AvgShift, uint8_t StallOverflows>
+bool PeriodMeter<Timer, Ch, AvgShift, StallOverflows>::started_;
+template<typename Timer, Timers::Channel Ch, uint8_t AvgShift, uint8_t StallOverflows>
+uint32_t PeriodMeter<Timer, Ch, AvgShift, StallOverflows>::lastRise_;
+template<typename Timer, Timers::Channel Ch, uint8_t AvgShift, uint8_t StallOverflows>
+uint32_t PeriodMeter<Timer, Ch, AvgShift, StallOverflows>::high_;
+template<typename Timer, Timers::Channel Ch, uint8_t AvgShift, uint8_t StallOverflows>
+uint32_t PeriodMeter<Timer, Ch, AvgShift, StallOverflows>::periodSum_;
+template<typename Timer, Timers::Channel Ch, uint8_t AvgShift, uint8_t StallOverflows>
+uint32_t PeriodMeter<Timer, Ch, AvgShift, StallOverflows>::highSum_;
+template<typename Timer, Timers::Channel Ch, uint8_t AvgShift, uint8_t StallOverflows>
+volatile uint32_t PeriodMeter<Timer, Ch, AvgShift, StallOverflows>::period_;
+template<typename Timer, Timers::Channel Ch, uint8_t AvgShift, uint8_t StallOverflows>
+volatile uint32_t PeriodMeter<Timer, Ch, AvgShift, StallOverflows>::highTime_;
+
+} // Capture
+} // Mcudrv
+
+#endif // CAPTURE_H
@@ -28,6 +28,16 @@
 #error "F_CPU should be defined"
 #endif
 
+#ifndef HSE_VALUE
+#define HSE_VALUE 16000000UL
+#endif
+
+// Highest runtime clock as F_CPU << SYSCLOCK_MAX_SHIFT, 0 - the clock is always F_CPU.
+// Templated delays dispatch on the current clock when it's not 0.
+#ifndef SYSCLOCK_MAX_SHIFT
+#define SYSCLOCK_MAX_SHIFT 0
+#endif
+
 namespace Mcudrv {
 namespace SysClock {
 enum RefSource
@@ -44,16 +54,29 @@ enum HsiDiv
     Div8 // Div8 - Default
 };
 
+// Non-blocking clock switch: StartSelect(), then poll IsSelectDone() (e.g. PT_WAIT_UNTIL).
+// SWBSY is set by the SWR write itself, so there is nothing to wait for here.
 #pragma inline = forced
-inline static void Select(const RefSource ref)
+inline static void StartSelect(const RefSource ref)
 {
     CLK->SWCR |= CLK_SWCR_SWEN;
     CLK->SWR = ref;
-    while(!(CLK->SWCR & CLK_SWCR_SWBSY))
-        ;
-    while(CLK->SWCR & CLK_SWCR_SWBSY)
-        ;
+}
+#pragma inline = forced
+inline static bool IsSelectDone()
+{
+    if(CLK->SWCR & CLK_SWCR_SWBSY) {
+        return false;
+    }
     CLK->SWCR = 0;
+    return true;
+}
+#pragma inline = forced
+inline static void Select(const RefSource ref)
+{
+    StartSelect(ref);
+    while(!IsSelectDone())
+        ;
 }
 #pragma inline = forced
 inline static void SetHsiDivider(const HsiDiv div)
@@ -61,5 +84,107 @@ inline static void SetHsiDivider(const HsiDiv div)
     CLK->CKDIVR = div << 3U;
 }
 
+// Clock configuration, fMASTER = fCPU
+template<RefSource ref, HsiDiv div = Div1>
+struct Config
+{
+    static const RefSource source = ref;
+    static const HsiDiv hsiDiv = div;
+    static const uint32_t freq = ref == HSE ? HSE_VALUE : ref == LSI ? 128000UL : 16000000UL >> div;
+};
+typedef Config<HSI, Div8> Hsi2MHz; // Reset default
+typedef Config<HSI, Div4> Hsi4MHz;
+typedef Config<HSI, Div2> Hsi8MHz;
+typedef Config<HSI, Div1> Hsi16MHz;
+typedef Config<HSE> Hse;
+
+namespace Internal {
+// Current clock is F_CPU << shift
+template<typename T = void>
+struct State
+{
+    static uint8_t shift;
+};
+template<typename T>
+uint8_t State<T>::shift;
+
+template<uint32_t freq, uint8_t shift = 0, bool stop = ((uint32_t)F_CPU << shift) == freq || shift >= SYSCLOCK_MAX_SHIFT>
+struct ShiftOf
+{
+    static const uint8_t value = ShiftOf<freq, shift + 1>::value;
+};
+template<uint32_t freq, uint8_t shift>
+struct ShiftOf<freq, shift, true>
+{
+    static const uint8_t value = shift;
+};
+
+template<typename... Listeners>
+struct Notify;
+template<>
+struct Notify<>
+{
+    static void Before()
+    { }
+    static void After(int8_t)
+    { }
+};
+template<typename First, typename... Rest>
+struct Notify<First, Rest...>
+{
+    static void Before()
+    {
+        First::BeforeClockChange();
+        Notify<Rest...>::Before();
+    }
+    static void After(int8_t scale)
+    {
+        First::OnClockChange(scale);
+        Notify<Rest...>::After(scale);
+    }
+};
+} // Internal
+
+// log2(current clock / F_CPU)
+#pragma inline = forced
+inline uint8_t GetShift()
+{
+    return Internal::State<>::shift;
+}
+#pragma inline = forced
+inline uint32_t GetFreq()
+{
+    return (uint32_t)F_CPU << GetShift();
+}
+
+// Runtime clock switch. F_CPU is the lowest clock, others are F_CPU * 2^n up to SYSCLOCK_MAX_SHIFT,
+// so dividers derived from F_CPU are rescaled by shifts.
+// Listeners are classes with static BeforeClockChange() (e.g. wait for the end of transmission) and
+// OnClockChange(int8_t scale), scale = log2(new clock / previous clock), GetFreq() returns the new clock.
+template<typename... Listeners>
+struct ClockManager
+{
+    template<typename Cfg>
+    static void Switch()
+    {
+        static const uint8_t shift = Internal::ShiftOf<Cfg::freq>::value;
+        static_assert(((uint32_t)F_CPU << shift) == Cfg::freq, "Clock should be F_CPU << 0...SYSCLOCK_MAX_SHIFT");
+        static_assert(Cfg::freq <= 16000000UL, "Flash wait state is needed above 16 MHz");
+        const int8_t scale = int8_t(shift - GetShift());
+        if(!scale && CLK->CMSR == Cfg::source) {
+            return;
+        }
+        Internal::Notify<Listeners...>::Before();
+        if(Cfg::source == HSI) {
+            SetHsiDivider(Cfg::hsiDiv);
+        }
+        if(CLK->CMSR != Cfg::source) {
+            Select(Cfg::source);
+        }
+        Internal::State<>::shift = shift;
+        Internal::Notify<Listeners...>::After(scale);
+    }
+};
+
 } // Clock
 } // Mcudrv
@@ -24,48 +24,13 @@
 #ifndef CRC_H
 #define CRC_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include "type_traits.h"
 
 namespace Mcudrv {
 namespace Crc {
 
-// Maxim-Dallas computation (X8 + X5 + X4 + 1)
-class Crc8
-{
-private:
-    typedef Crc8 Self;
-    static const uint8_t table[256];
-    uint8_t crc_;
-public:
-    //	Crc8(uint8_t init = 0) : crc_(init)
-    //	{	}
-    void Init(uint8_t init)
-    {
-        crc_ = init;
-    }
-    Self& Reset(uint8_t init = 0)
-    {
-        crc_ = init;
-        return *this;
-    }
-    Self& operator()(uint8_t value)
-    {
-        crc_ = table[crc_ ^ value];
-        return *this;
-    }
-    Self& operator()(const uint8_t* buf, uint8_t len)
-    {
-        for(uint8_t i = 0; i < len; ++i) {
-            crc_ = table[crc_ ^ buf[i]];
-        }
-        return *this;
-    }
-    uint8_t GetResult()
-    {
-        return crc_;
-    }
-};
-
 namespace NoLUT {
 
 struct Crc8_Algo1
@@ -104,6 +69,11 @@ private:
     typedef Crc8 Self;
     uint8_t crc_;
 public:
+    typedef uint8_t value_type;
+    enum
+    {
+        TableSize = 0
+    };
     //  Crc8(uint8_t init = 0) : crc_(init)
     //	{	}
     void Init(uint8_t init)
@@ -138,6 +108,351 @@ public:
 
 typedef NoLUT::Crc8<NoLUT::Crc8_Algo1> Crc8_NoLUT;
 
+// ---=== Generic CRC engine ===---
+//
+// Parameters follow the Rocksoft model (Width, Poly, Init, RefIn, RefOut, XorOut).
+// For reflected models the register is kept reflected and shifted right, otherwise it's
+// kept in its natural form and shifted left. All lookup tables are generated by the compiler
+// from the model parameters and placed in flash as const arrays.
+
+namespace Internal {
+
+template<uint32_t Value, uint8_t Width>
+struct Reflect
+{
+    static const uint32_t value = ((Value & 0x01UL) << (Width - 1)) | Reflect<(Value >> 1), Width - 1>::value;
+};
+template<uint32_t Value>
+struct Reflect<Value, 0>
+{
+    static const uint32_t value = 0;
+};
+
+#pragma inline = forced
+template<typename T>
+T ReflectValue(T value, uint8_t width)
+{
+    T result = 0;
+    for(uint8_t i = width; i; --i) {
+        result = (result << 1) | (value & 0x01);
+        value >>= 1;
+    }
+    return result;
+}
+
+template<uint8_t Width, uint32_t Poly, bool Reflected>
+struct CrcModel
+{
+    static_assert(Width >= 8 && Width <= 32, "CRC width must be in range 8...32");
+    typedef typename stdx::SelectSize<Width>::type value_type;
+    enum
+    {
+        width = Width,
+        reflected = Reflected
+    };
+    static const uint32_t Mask = ((1UL << (Width - 1)) << 1) - 1;
+    static const value_type TopBit = value_type(1UL << (Width - 1));
+    static const value_type Polynomial = value_type(Poly);
+    static const value_type RPoly = value_type(Reflect<Poly, Width>::value);
+    static const value_type RegMask = value_type(Mask);
+
+    // Register value after shifting Bits zero bits through it
+    template<uint32_t Reg, uint8_t Bits>
+    struct Shift
+    {
+        static const uint32_t next = Reflected ? ((Reg & 0x01) ? (Reg >> 1) ^ RPoly : Reg >> 1)
+                                               : ((Reg & TopBit) ? (Reg << 1) ^ Poly : Reg << 1) & Mask;
+        static const uint32_t value = Shift<next, Bits - 1>::value;
+    };
+    template<uint32_t Reg>
+    struct Shift<Reg, 0>
+    {
+        static const uint32_t value = Reg;
+    };
+
+    template<unsigned I>
+    struct NibbleEntry
+    {
+        static const uint32_t value = Shift<(Reflected ? I : (uint32_t)I << (Width - 4)), 4>::value;
+    };
+    template<unsigned I>
+    struct ByteEntry
+    {
+        static const uint32_t value = Shift<(Reflected ? I : (uint32_t)I << (Width - 8)), 8>::value;
+    };
+    // Entry I of slice K (flattened as K * 256 + I): CRC of byte I followed by K zero bytes
+    template<unsigned Index, bool FirstSlice = (Index < 256)>
+    struct SliceStep
+    {
+        static const uint32_t prev = SliceStep<Index - 256>::value;
+        static const uint32_t value = ByteEntry<prev & 0xFF>::value ^ (prev >> 8);
+    };
+    template<unsigned Index>
+    struct SliceStep<Index, true>
+    {
+        static const uint32_t value = ByteEntry<Index>::value;
+    };
+    template<unsigned Index>
+    struct SliceEntry
+    {
+        static const uint32_t value = SliceStep<Index>::value;
+    };
+};
+
+template<typename Model, template<unsigned> class Entry, typename Indices>
+struct LutHolder;
+template<typename Model, template<unsigned> class Entry, unsigned... I>
+struct LutHolder<Model, Entry, stdx::IndexList<I...> >
+{
+    static const typename Model::value_type table[sizeof...(I)];
+};
+template<typename Model, template<unsigned> class Entry, unsigned... I>
+const typename Model::value_type LutHolder<Model, Entry, stdx::IndexList<I...> >::table[sizeof...(I)] = {
+    (typename Model::value_type)Entry<I>::value...
+};
+
+template<typename Model, unsigned Size>
+struct NibbleLut : LutHolder<Model, Model::template NibbleEntry, typename stdx::MakeIndexList<Size>::type>
+{
+};
+template<typename Model, unsigned Size>
+struct ByteLut : LutHolder<Model, Model::template ByteEntry, typename stdx::MakeIndexList<Size>::type>
+{
+};
+template<typename Model, unsigned Size>
+struct SliceLut : LutHolder<Model, Model::template SliceEntry, typename stdx::MakeIndexList<Size>::type>
+{
+};
+
+} // Internal
+
+// ---=== Computation strategies ===---
+
+// No table, 8 iterations per byte
+struct Bitwise
+{
+    enum
+    {
+        TableEntries = 0
+    };
+    template<typename Model>
+    static void Evaluate(typename Model::value_type& crc, uint8_t inByte)
+    {
+        typedef typename Model::value_type T;
+        if(Model::reflected) {
+            crc ^= inByte;
+            for(uint8_t i = 8; i; --i) {
+                crc = (crc & 0x01) ? T((crc >> 1) ^ Model::RPoly) : T(crc >> 1);
+            }
+        }
+        else {
+            crc ^= T((uint32_t)inByte << (Model::width - 8));
+            for(uint8_t i = 8; i; --i) {
+                crc = (crc & Model::TopBit) ? T((crc << 1) ^ Model::Polynomial) & Model::RegMask
+                                            : T(crc << 1) & Model::RegMask;
+            }
+        }
+    }
+    template<typename Model>
+    static void Evaluate(typename Model::value_type& crc, const uint8_t* buf, size_t len)
+    {
+        while(len--) {
+            Evaluate<Model>(crc, *buf++);
+        }
+    }
+};
+
+// 16 entries table, two lookups per byte
+struct Nibble
+{
+    enum
+    {
+        TableEntries = 16
+    };
+    template<typename Model>
+    static void Evaluate(typename Model::value_type& crc, uint8_t inByte)
+    {
+        typedef typename Model::value_type T;
+        typedef Internal::NibbleLut<Model, TableEntries> Lut;
+        if(Model::reflected) {
+            crc = Lut::table[(crc ^ inByte) & 0x0F] ^ T(crc >> 4);
+            crc = Lut::table[(crc ^ (inByte >> 4)) & 0x0F] ^ T(crc >> 4);
+        }
+        else {
+            crc = Lut::table[((crc >> (Model::width - 4)) ^ (inByte >> 4)) & 0x0F] ^ (T(crc << 4) & Model::RegMask);
+            crc = Lut::table[((crc >> (Model::width - 4)) ^ inByte) & 0x0F] ^ (T(crc << 4) & Model::RegMask);
+        }
+    }
+    template<typename Model>
+    static void Evaluate(typename Model::value_type& crc, const uint8_t* buf, size_t len)
+    {
+        while(len--) {
+            Evaluate<Model>(crc, *buf++);
+        }
+    }
+};
+
+// 256 entries table, one lookup per byte
+struct Table
+{
+    enum
+    {
+        TableEntries = 256
+    };
+    template<typename Model>
+    static void Evaluate(typename Model::value_type& crc, uint8_t inByte)
+    {
+        typedef typename Model::value_type T;
+        typedef Internal::ByteLut<Model, TableEntries> Lut;
+        if(Model::reflected) {
+            crc = Lut::table[uint8_t(crc ^ inByte)] ^ T(crc >> 8);
+        }
+        else {
+            crc = Lut::table[uint8_t((crc >> (Model::width - 8)) ^ inByte)] ^ (T(crc << 8) & Model::RegMask);
+        }
+    }
+    template<typename Model>
+    static void Evaluate(typename Model::value_type& crc, const uint8_t* buf, size_t len)
+    {
+        while(len--) {
+            Evaluate<Model>(crc, *buf++);
+        }
+    }
+};
+
+#if !defined(__ICCSTM8__)
+// Slicing-by-N (N = 4 or 8), reflected models only. Tables take N * 256 entries,
+// so this is meant for host side tools and tests.
+template<uint8_t N>
+struct Slice
+{
+    static_assert(N == 4 || N == 8, "Slice size must be 4 or 8");
+    enum
+    {
+        TableEntries = N * 256
+    };
+    template<typename Model>
+    static void Evaluate(typename Model::value_type& crc, uint8_t inByte)
+    {
+        Table::Evaluate<Model>(crc, inByte);
+    }
+    template<typename Model>
+    static void Evaluate(typename Model::value_type& crc, const uint8_t* buf, size_t len)
+    {
+        static_assert(Model::reflected, "Slicing is implemented for reflected models only");
+        typedef typename Model::value_type T;
+        typedef Internal::SliceLut<Model, TableEntries> Lut;
+        const typename Model::value_type* const t = Lut::table;
+        for(; len >= N; len -= N, buf += N) {
+            uint32_t x = crc ^ Word(buf);
+            uint32_t result = t[(N - 1) * 256 + (x & 0xFF)] ^ t[(N - 2) * 256 + ((x >> 8) & 0xFF)] ^
+                              t[(N - 3) * 256 + ((x >> 16) & 0xFF)] ^ t[(N - 4) * 256 + (x >> 24)];
+            if(N == 8) {
+                x = Word(buf + 4);
+                result ^= t[3 * 256 + (x & 0xFF)] ^ t[2 * 256 + ((x >> 8) & 0xFF)] ^ t[1 * 256 + ((x >> 16) & 0xFF)] ^
+                          t[x >> 24];
+            }
+            crc = T(result);
+        }
+        while(len--) {
+            Evaluate<Model>(crc, *buf++);
+        }
+    }
+private:
+    static uint32_t Word(const uint8_t* buf)
+    {
+        return buf[0] | (uint32_t)buf[1] << 8 | (uint32_t)buf[2] << 16 | (uint32_t)buf[3] << 24;
+    }
+};
+typedef Slice<4> Slice4;
+typedef Slice<8> Slice8;
+#endif
+
+// ---=== Main class ===---
+
+template<uint8_t Width, uint32_t Poly, uint32_t InitVal, bool RefIn, bool RefOut, uint32_t XorOut, typename Algo = Table>
+class Crc
+{
+private:
+    typedef Crc Self;
+    typedef Internal::CrcModel<Width, Poly, RefIn> Model;
+public:
+    typedef typename Model::value_type value_type;
+    enum
+    {
+        TableSize = Algo::TableEntries * sizeof(value_type) // bytes of flash used by the lookup table
+    };
+private:
+    value_type crc_;
+public:
+    // Initial value of the register (reflected for RefIn models)
+    static const value_type InitValue = value_type(RefIn ? Internal::Reflect<InitVal, Width>::value : InitVal);
+
+    Crc() : crc_(InitValue)
+    { }
+    // Loads the register as is, without reflection
+    void Init(value_type init)
+    {
+        crc_ = init;
+    }
+    Self& Reset()
+    {
+        crc_ = InitValue;
+        return *this;
+    }
+    Self& Reset(value_type init)
+    {
+        crc_ = init;
+        return *this;
+    }
+    Self& operator()(uint8_t value)
+    {
+        Algo::template Evaluate<Model>(crc_, value);
+        return *this;
+    }
+    Self& operator()(const uint8_t* buf, size_t len)
+    {
+        Algo::template Evaluate<Model>(crc_, buf, len);
+        return *this;
+    }
+    value_type GetResult() const
+    {
+        value_type result = crc_;
+        if(RefIn != RefOut) {
+            result = Internal::ReflectValue(result, Width);
+        }
+        return value_type(result ^ XorOut);
+    }
+    static value_type Calculate(const uint8_t* buf, size_t len)
+    {
+        return Self()(buf, len).GetResult();
+    }
+};
+
+template<uint8_t Width, uint32_t Poly, uint32_t InitVal, bool RefIn, bool RefOut, uint32_t XorOut, typename Algo>
+const typename Crc<Width, Poly, InitVal, RefIn, RefOut, XorOut, Algo>::value_type
+  Crc<Width, Poly, InitVal, RefIn, RefOut, XorOut, Algo>::InitValue;
+
+// ---=== Common models ===---
+//
+// Flash cost of the lookup table is reported by Crc<...>::TableSize, e.g. 256 bytes for Crc8,
+// 16 bytes for Crc8_Nibble, 1024 bytes for Crc32. Bitwise and NoLUT engines have no table
+// but run 8 iterations per byte, which matters when CRC is updated in an ISR.
+// tests/crc_test.cpp checks every engine and compares their speed on the host.
+
+// Maxim-Dallas computation (X8 + X5 + X4 + 1), check value 0xA1
+typedef Crc<8, 0x31, 0x00, true, true, 0x00> Crc8;
+typedef Crc<8, 0x31, 0x00, true, true, 0x00, Nibble> Crc8_Nibble;
+typedef Crc<8, 0x31, 0x00, true, true, 0x00, Bitwise> Crc8_Bitwise;
+// CRC-16/CCITT-FALSE, check value 0x29B1
+typedef Crc<16, 0x1021, 0xFFFF, false, false, 0x0000> Crc16Ccitt;
+// CRC-16/XMODEM, check value 0x31C3
+typedef Crc<16, 0x1021, 0x0000, false, false, 0x0000> Crc16Xmodem;
+// CRC-16/MODBUS, check value 0x4B37
+typedef Crc<16, 0x8005, 0xFFFF, true, true, 0x0000> Crc16Modbus;
+// CRC-32 (Ethernet, zlib), check value 0xCBF43926
+typedef Crc<32, 0x04C11DB7, 0xFFFFFFFF, true, true, 0xFFFFFFFF> Crc32;
+
 } // Crc
 } // Mcudrv
 
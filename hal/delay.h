@@ -20,93 +20,161 @@
  * SOFTWARE.
  */
 
+
 #pragma once
 
-// platform specific delay loop implementation
+#include "clock.h"
+#include "stm8s.h"
 #include <stdint.h>
 
+// Busy-wait delays counted in CPU cycles. The loop is written in assembly (IAR) so the count doesn't
+// depend on the optimization level, the cycle numbers are from PM0044 for code executing from flash
+// without wait states (F_CPU <= 16 MHz). Interrupts taken during the delay extend it.
+// Delays are rounded up to whole cycles, never shorter than requested.
+// The 3 cycles per iteration hold when DECW X and JRNE come in one 32 bit fetch, so DelayLoop
+// (delay.cpp) is linked at a 4 byte boundary: the linker configuration has to place section
+// .delay_loop.text in an aligned block, as the files in linker/ do. tests/delay_test.cpp checks the
+// split arithmetic against these timings, the cycle counts aren't validated on a simulator.
+
 namespace Mcudrv {
+namespace Internal {
 enum
 {
-    PlatformCyslesPerDelayLoop32 = 42,
-    PlatformCyslesPerDelayLoop16 = 6,
-    PlatformCyslesPerDelayLoop8 = 5
+    PlatformCyclesPerLoop = 3, // DECW X (1) + JRNE taken (2), the last JRNE isn't taken (1)
+#if defined(_IAR_) && (__CODE_MODEL__ == __LARGE_CODE_MODEL__)
+    PlatformLoopOverhead = 11, // LDW X,#n (2) + CALLF (5) + RETF (5) - 1
+#else
+    PlatformLoopOverhead = 9, // LDW X,#n (2) + CALL (4) + RET (4) - 1
+#endif
+    PlatformLoopMinCycles = PlatformLoopOverhead + PlatformCyclesPerLoop, // shorter delays are done by NOPs
+    PlatformLoopMax = 0xFFFF
 };
+static const unsigned long PlatformLoopMaxCycles = PlatformLoopMax * 3UL + PlatformLoopOverhead;
 
-//	namespace Ndelay
-//	{
-//	{
-#pragma inline = forced
-inline void DelayCycle32(uint32_t delayLoops)
+// loops in X by the calling convention
+#if defined(_IAR_)
+void DelayLoop(uint16_t loops);
+#else
+// No cycle accuracy on host and other compilers
+inline void DelayLoop(uint16_t loops)
 {
-    do {
-        // TODO: rewrite in assembly
-        // __no_operation();
-    } while(delayLoops--);
+    volatile uint16_t n = loops;
+    while(--n)
+        ;
 }
+#endif
+
+template<unsigned long cycles>
+struct Nops
+{
 #pragma inline = forced
-inline void DelayCycle16(uint16_t delayLoops)
+    static void Run()
+    {
+        __no_operation();
+        Nops<cycles - 1>::Run();
+    }
+};
+template<>
+struct Nops<0>
+{
+    static void Run()
+    { }
+};
+
+template<unsigned long cycles,
+         int kind = (cycles < PlatformLoopMinCycles ? 0 : cycles <= PlatformLoopMaxCycles ? 1 : 2)>
+struct Delay;
+template<unsigned long cycles>
+struct Delay<cycles, 0>
 {
-    do {
-        // TODO: rewrite in assembly
-        // __no_operation();
-    } while(delayLoops--);
-}
 #pragma inline = forced
-inline void DelayCycle8(uint8_t delayLoops)
+    static void Run()
+    {
+        Nops<cycles>::Run();
+    }
+};
+template<unsigned long cycles>
+struct Delay<cycles, 1>
 {
-    do {
-        // TODO: rewrite in assembly
-        // __no_operation();
-    } while(delayLoops--);
+    static const uint16_t loops = (cycles - PlatformLoopOverhead) / PlatformCyclesPerLoop;
+    static const uint8_t rest = (cycles - PlatformLoopOverhead) % PlatformCyclesPerLoop;
+    static_assert(loops * (unsigned long)PlatformCyclesPerLoop + PlatformLoopOverhead + rest == cycles,
+                  "Delay cycles mismatch");
+#pragma inline = forced
+    static void Run()
+    {
+        DelayLoop(loops);
+        Nops<rest>::Run();
+    }
+};
+// Longer than one loop call
+template<unsigned long cycles>
+struct Delay<cycles, 2>
+{
+#pragma inline = forced
+    static void Run()
+    {
+        DelayLoop(PlatformLoopMax);
+        Delay<cycles - PlatformLoopMaxCycles>::Run();
+    }
+};
+
+// Selects the delay for the current clock, F_CPU << shift
+template<unsigned long cycles, uint8_t shift = SYSCLOCK_MAX_SHIFT>
+struct ScaledDelay
+{
+#pragma inline = forced
+    static void Run(uint8_t currentShift)
+    {
+        if(currentShift == shift) {
+            Delay<(cycles << shift)>::Run();
+        }
+        else {
+            ScaledDelay<cycles, shift - 1>::Run(currentShift);
+        }
+    }
+};
+template<unsigned long cycles>
+struct ScaledDelay<cycles, 0>
+{
+#pragma inline = forced
+    static void Run(uint8_t)
+    {
+        Delay<cycles>::Run();
+    }
+};
+} // Internal
+
+// Cycles of F_CPU, scaled to the current clock when SYSCLOCK_MAX_SHIFT is set (a few cycles longer then)
+#pragma inline = forced
+template<unsigned long cycles>
+void delay_cycles()
+{
+    Internal::ScaledDelay<cycles>::Run(SysClock::GetShift());
 }
 
-// 	#pragma inline=forced
-// 	template<unsigned long ns, unsigned long CpuFreq = Fcpu>
-// 	void delay_ns()
-// 	{
-// //		const unsigned long delayLoops32 = (unsigned long)(CpuFreq / (1.0e9 * PlatformCyslesPerDelayLoop32) *
-// ns); 			const unsigned long delayLoops16 = (unsigned long)(CpuFreq / (1.0e9 *
-// PlatformCyslesPerDelayLoop16) * ns); 			const unsigned long delayLoops8 = (unsigned
-// long)(CpuFreq / (1.0e9 * PlatformCyslesPerDelayLoop8) * ns); 			if(delayLoops16 > 0xfffful);
-// #pragma message("Too Large Loop")
-// 				//DelayCycle32(delayLoops32);
-// 			else if(delayLoops8 > 0xfful)
-// 				DelayCycle16((uint16_t)delayLoops16);
-//  			else
-//  			{
-//  				if(delayLoops8 == 0) return;
-//  				DelayCycle8((uint8_t)delayLoops8);
-//  			}
-// 	}
+#pragma inline = forced
+template<unsigned long ns, unsigned long CpuFreq = F_CPU>
+void delay_ns()
+{
+    static_assert(ns <= 100000UL, "Use delay_us for longer delays");
+    delay_cycles<(ns * (CpuFreq / 1000) + 999999UL) / 1000000UL>();
+}
 
-#pragma diag_suppress = Pe111
 #pragma inline = forced
 template<unsigned long us, unsigned long CpuFreq = F_CPU>
 void delay_us()
 {
-    const unsigned long delayLoops32 = (unsigned long)(CpuFreq / (1.0e6 * PlatformCyslesPerDelayLoop32) * us);
-    const unsigned long delayLoops16 = (unsigned long)(CpuFreq / (1.0e6 * PlatformCyslesPerDelayLoop16) * us);
-    const unsigned long delayLoops8 = (unsigned long)(CpuFreq / (1.0e6 * PlatformCyslesPerDelayLoop8) * us);
-
-    if(delayLoops16 > 0xfffful)
-        DelayCycle32(delayLoops32);
-    else if(delayLoops8 > 0xfful)
-        DelayCycle16((uint16_t)delayLoops16);
-    else {
-        if(delayLoops8 == 0)
-            return;
-        DelayCycle8((uint8_t)delayLoops8);
-    }
+    static_assert(us <= 100000UL, "Use delay_ms for longer delays");
+    delay_cycles<(us * (CpuFreq / 1000) + 999) / 1000>();
 }
 
-//	#pragma inline=forced
-//	template<unsigned long ms, unsigned long CpuFreq = Fcpu>
-void delay_ms(uint16_t n)
+// Loop overhead adds a few cycles per millisecond
+inline void delay_ms(uint16_t n)
 {
     do {
         delay_us<1000>();
     } while(--n);
 }
 
-}
+} // Mcudrv
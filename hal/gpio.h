@@ -94,7 +94,7 @@ private:
 #pragma inline = forced
     static GPIO_TypeDef* GetBase()
     {
-        return reinterpret_cast<GPIO_TypeDef*>(baseaddr);
+        return MCUDRV_PERIPH(GPIO_TypeDef, baseaddr);
     }
 public:
     typedef Gpio Base;
@@ -205,14 +205,12 @@ public:
     template<uint8_t clearmask, uint8_t setmask>
     static void ClearAndSet()
     {
-        const DataT value = setmask & ~clearmask;
-        GetBase()->ODR = value;
+        GetBase()->ODR = (GetBase()->ODR & ~clearmask) | setmask;
     }
 #pragma inline = forced
     static void ClearAndSet(uint8_t clearmask, uint8_t setmask)
     {
-        const DataT value = setmask & ~clearmask;
-        GetBase()->ODR = value;
+        GetBase()->ODR = (GetBase()->ODR & ~clearmask) | setmask;
     }
 };
 
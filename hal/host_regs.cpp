@@ -0,0 +1,446 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifdef MCUDRV_HOST
+
+#include "stm8s.h"
+#include <string.h>
+
+namespace Mcudrv {
+namespace Host {
+
+uint8_t regFile[RegFileSize];
+bool irqEnabled;
+unsigned long nopCount;
+
+namespace {
+enum
+{
+    VectorCount = 32,
+    PortCount = 9,
+    UartQueueSize = 256,
+    MaxPollPasses = 1000
+};
+#if defined(STM8S105) || defined(STM8S005)
+typedef UART2_TypeDef UartRegs;
+const uint16_t UartBase = UART2_BaseAddress;
+const uint8_t UartTxVector = UART2_T_TXE_vector;
+const uint8_t UartRxVector = UART2_R_RXNE_vector;
+#else
+typedef UART1_TypeDef UartRegs;
+const uint16_t UartBase = UART1_BaseAddress;
+const uint8_t UartTxVector = UART1_T_TXE_vector;
+const uint8_t UartRxVector = UART1_R_RXNE_vector;
+#endif
+
+Isr isrTable[VectorCount];
+bool inIsr;
+PinCallback pinCallback;
+uint8_t portInputs[PortCount];
+uint8_t portOdr[PortCount];
+UartTxCallback uartTxCallback;
+JumpCallback jumpCallback;
+uint8_t uartQueue[UartQueueSize];
+uint8_t uartErrors[UartQueueSize];
+uint16_t uartHead, uartTail;
+bool uartIdlePending;
+uint16_t adcInputs[16];
+uint32_t prescCounters[4];
+
+GPIO_TypeDef* Port(uint8_t id)
+{
+    return MCUDRV_PERIPH(GPIO_TypeDef, GPIOA_BaseAddress + id * sizeof(GPIO_TypeDef));
+}
+UartRegs* Uart()
+{
+    return MCUDRV_PERIPH(UartRegs, UartBase);
+}
+
+bool Raise(uint8_t vector)
+{
+    if(!irqEnabled || inIsr || vector >= VectorCount || !isrTable[vector]) {
+        return false;
+    }
+    inIsr = true;
+    isrTable[vector]();
+    inIsr = false;
+    return true;
+}
+
+void SyncPorts()
+{
+    for(uint8_t i = 0; i < PortCount; ++i) {
+        GPIO_TypeDef* port = Port(i);
+        port->IDR = (port->ODR & port->DDR) | (portInputs[i] & ~port->DDR);
+        const uint8_t changed = port->ODR ^ portOdr[i];
+        if(changed) {
+            portOdr[i] = port->ODR;
+            if(pinCallback) {
+                pinCallback(i, port->ODR, changed);
+            }
+        }
+    }
+}
+
+bool PollUart()
+{
+    UartRegs* uart = Uart();
+    if(!(uart->SR & UART1_SR_RXNE) && uartHead != uartTail && (uart->CR2 & UART1_CR2_REN)) {
+        uart->DR = uartQueue[uartTail];
+        uart->SR |= UART1_SR_RXNE | uartErrors[uartTail];
+        uartTail = (uartTail + 1) % UartQueueSize;
+        uartIdlePending = true;
+    }
+    else if(uartIdlePending && !(uart->SR & UART1_SR_RXNE) && uartHead == uartTail) {
+        uart->SR |= UART1_SR_IDLE;
+        uartIdlePending = false;
+    }
+    const uint8_t sr = uart->SR, cr2 = uart->CR2;
+    bool raised = false;
+    if(((cr2 & UART1_CR2_RIEN) && (sr & (UART1_SR_RXNE | UART1_SR_OR))) ||
+       ((cr2 & UART1_CR2_ILIEN) && (sr & UART1_SR_IDLE))) {
+        raised |= Raise(UartRxVector);
+    }
+    if(((cr2 & UART1_CR2_TIEN) && (sr & UART1_SR_TXE)) || ((cr2 & UART1_CR2_TCIEN) && (sr & UART1_SR_TC))) {
+        raised |= Raise(UartTxVector);
+    }
+    return raised;
+}
+
+bool PollTimers()
+{
+    bool raised = false;
+    const uint8_t tim1 = TIM1->IER & TIM1->SR1;
+    if(tim1 & TIM1_SR1_UIF) {
+        raised |= Raise(TIM1_OVR_UIF_vector);
+    }
+    if(tim1 & ~TIM1_SR1_UIF) {
+        raised |= Raise(TIM1_CAPCOM_CC1IF_vector);
+    }
+    const uint8_t tim2 = TIM2->IER & TIM2->SR1;
+    if(tim2 & TIM2_SR1_UIF) {
+        raised |= Raise(TIM2_OVR_UIF_vector);
+    }
+    if(tim2 & ~TIM2_SR1_UIF) {
+        raised |= Raise(TIM2_CAPCOM_CC1IF_vector);
+    }
+#ifdef TIM3
+    const uint8_t tim3 = TIM3->IER & TIM3->SR1;
+    if(tim3 & TIM3_SR1_UIF) {
+        raised |= Raise(TIM3_OVR_UIF_vector);
+    }
+    if(tim3 & ~TIM3_SR1_UIF) {
+        raised |= Raise(TIM3_CAPCOM_CC1IF_vector);
+    }
+#endif
+    if(TIM4->IER & TIM4->SR1 & TIM4_SR1_UIF) {
+        raised |= Raise(TIM4_OVR_UIF_vector);
+    }
+    return raised;
+}
+
+bool PollAdc()
+{
+    if((ADC1->CSR & ADC1_CSR_EOCIE) && (ADC1->CSR & ADC1_CSR_EOC)) {
+        return Raise(ADC1_EOC_vector);
+    }
+    return false;
+}
+
+uint16_t ReadWord(volatile uint8_t& high)
+{
+    return uint16_t(high << 8) | (&high)[1];
+}
+void WriteWord(volatile uint8_t& high, uint16_t value)
+{
+    high = value >> 8;
+    (&high)[1] = uint8_t(value);
+}
+
+// One timer clock tick: counter, update and compare flags of the channels in output mode
+template<typename TIM_TypeDef>
+void CountTick(TIM_TypeDef* tim, volatile uint8_t* const ccmr[], volatile uint8_t* const ccr[], uint8_t channels)
+{
+    uint16_t counter = ReadWord(tim->CNTRH);
+    if(counter == ReadWord(tim->ARRH)) {
+        counter = 0;
+        tim->SR1 |= 0x01; // UIF
+    }
+    else {
+        ++counter;
+    }
+    WriteWord(tim->CNTRH, counter);
+    for(uint8_t ch = 0; ch < channels; ++ch) {
+        if(!(*ccmr[ch] & 0x03) && counter == ReadWord(*ccr[ch])) {
+            tim->SR1 |= 0x02 << ch;
+        }
+    }
+}
+
+template<typename TIM_TypeDef>
+void Capture(TIM_TypeDef* tim, uint8_t ch)
+{
+    if(!((&tim->CCMR1)[ch] & 0x03)) {
+        return;
+    }
+    if(tim->SR1 & (0x02 << ch)) {
+        tim->SR2 |= 0x02 << ch; // CCxOF
+    }
+    tim->SR1 |= 0x02 << ch;
+    WriteWord((&tim->CCR1H)[ch * 2], ReadWord(tim->CNTRH));
+}
+
+bool Prescale(uint8_t timer, uint32_t divider)
+{
+    if(++prescCounters[timer] < divider) {
+        return false;
+    }
+    prescCounters[timer] = 0;
+    return true;
+}
+} // namespace
+
+void Reset()
+{
+    memset(regFile, 0, sizeof(regFile));
+    memset(isrTable, 0, sizeof(isrTable));
+    memset(portInputs, 0, sizeof(portInputs));
+    memset(portOdr, 0, sizeof(portOdr));
+    memset(prescCounters, 0, sizeof(prescCounters));
+    pinCallback = 0;
+    uartTxCallback = 0;
+    jumpCallback = 0;
+    uartHead = uartTail = 0;
+    uartIdlePending = false;
+    irqEnabled = false;
+    inIsr = false;
+    nopCount = 0;
+    Uart()->SR = UART1_SR_TXE | UART1_SR_TC;
+    CLK->ICKR = CLK_ICKR_RESET_VALUE | CLK_ICKR_HSIRDY | CLK_ICKR_LSIRDY;
+    CLK->CMSR = CLK_CMSR_RESET_VALUE;
+    CLK->CKDIVR = CLK_CKDIVR_RESET_VALUE;
+    TIM1->ARRH = TIM1->ARRL = 0xFF;
+    TIM2->ARRH = TIM2->ARRL = 0xFF;
+#ifdef TIM3
+    TIM3->ARRH = TIM3->ARRL = 0xFF;
+#endif
+    TIM4->ARR = 0xFF;
+}
+
+void AttachIsr(uint8_t vector, Isr isr)
+{
+    if(vector < VectorCount) {
+        isrTable[vector] = isr;
+    }
+}
+
+void Poll()
+{
+    for(uint16_t pass = 0; pass < MaxPollPasses; ++pass) {
+        SyncPorts();
+        bool raised = PollUart();
+        raised |= PollTimers();
+        raised |= PollAdc();
+        if(!raised) {
+            break;
+        }
+    }
+    SyncPorts();
+}
+
+void SetInput(uint8_t portId, uint8_t mask, bool level)
+{
+    if(portId >= PortCount) {
+        return;
+    }
+    if(level) {
+        portInputs[portId] |= mask;
+    }
+    else {
+        portInputs[portId] &= ~mask;
+    }
+    SyncPorts();
+}
+
+void SetPinCallback(PinCallback cb)
+{
+    pinCallback = cb;
+}
+
+bool UartReceive(uint8_t c, uint8_t errors)
+{
+    const uint16_t next = (uartHead + 1) % UartQueueSize;
+    if(next == uartTail) {
+        return false;
+    }
+    uartQueue[uartHead] = c;
+    uartErrors[uartHead] = errors;
+    uartHead = next;
+    return true;
+}
+
+void SetUartTxCallback(UartTxCallback cb)
+{
+    uartTxCallback = cb;
+}
+
+void UartWritten(uint16_t)
+{
+    UartRegs* uart = Uart();
+    if(uartTxCallback && (uart->CR2 & UART1_CR2_TEN)) {
+        uartTxCallback(uart->DR);
+    }
+    uart->SR |= UART1_SR_TXE | UART1_SR_TC;
+}
+
+void UartRead(uint16_t)
+{
+    // SR read followed by DR read clears the error and IDLE flags as well
+    Uart()->SR &= ~(UART1_SR_RXNE | UART1_SR_IDLE | UART1_SR_OR | UART1_SR_NF | UART1_SR_FE | UART1_SR_PE);
+}
+
+void AdvanceTimers(uint32_t ticks)
+{
+    volatile uint8_t* const ccmr1[] = { &TIM1->CCMR1, &TIM1->CCMR2, &TIM1->CCMR3, &TIM1->CCMR4 };
+    volatile uint8_t* const ccr1[] = { &TIM1->CCR1H, &TIM1->CCR2H, &TIM1->CCR3H, &TIM1->CCR4H };
+    volatile uint8_t* const ccmr2[] = { &TIM2->CCMR1, &TIM2->CCMR2, &TIM2->CCMR3 };
+    volatile uint8_t* const ccr2[] = { &TIM2->CCR1H, &TIM2->CCR2H, &TIM2->CCR3H };
+#ifdef TIM3
+    volatile uint8_t* const ccmr3[] = { &TIM3->CCMR1, &TIM3->CCMR2 };
+    volatile uint8_t* const ccr3[] = { &TIM3->CCR1H, &TIM3->CCR2H };
+#endif
+    while(ticks--) {
+        bool counted = false;
+        if((TIM1->CR1 & TIM1_CR1_CEN) && Prescale(0, ReadWord(TIM1->PSCRH) + 1UL)) {
+            CountTick(TIM1, ccmr1, ccr1, 4);
+            counted = true;
+        }
+        if((TIM2->CR1 & TIM2_CR1_CEN) && Prescale(1, 1UL << (TIM2->PSCR & 0x0F))) {
+            CountTick(TIM2, ccmr2, ccr2, 3);
+            counted = true;
+        }
+#ifdef TIM3
+        if((TIM3->CR1 & TIM3_CR1_CEN) && Prescale(2, 1UL << (TIM3->PSCR & 0x0F))) {
+            CountTick(TIM3, ccmr3, ccr3, 2);
+            counted = true;
+        }
+#endif
+        if((TIM4->CR1 & TIM4_CR1_CEN) && Prescale(3, 1UL << (TIM4->PSCR & 0x07))) {
+            if(TIM4->CNTR == TIM4->ARR) {
+                TIM4->CNTR = 0;
+                TIM4->SR1 |= TIM4_SR1_UIF;
+            }
+            else {
+                ++TIM4->CNTR;
+            }
+            counted = true;
+        }
+        if(counted) {
+            Poll();
+        }
+    }
+}
+
+void TimerCapture(uint16_t base, uint8_t ch)
+{
+    if(base == TIM1_BaseAddress) {
+        Capture(TIM1, ch);
+    }
+    else if(base == TIM2_BaseAddress) {
+        Capture(TIM2, ch);
+    }
+#ifdef TIM3
+    else if(base == TIM3_BaseAddress) {
+        Capture(TIM3, ch);
+    }
+#endif
+    Poll();
+}
+
+void CaptureRead(uint16_t base, uint8_t ch)
+{
+    const uint8_t mask = 0x02 << ch;
+    if(base == TIM1_BaseAddress) {
+        TIM1->SR1 &= ~mask;
+    }
+    else if(base == TIM2_BaseAddress) {
+        TIM2->SR1 &= ~mask;
+    }
+#ifdef TIM3
+    else if(base == TIM3_BaseAddress) {
+        TIM3->SR1 &= ~mask;
+    }
+#endif
+}
+
+void SetAdcInput(uint8_t channel, uint16_t value)
+{
+    adcInputs[channel & 0x0F] = value;
+}
+
+void AdcConvert()
+{
+    if(!(ADC1->CR1 & ADC1_CR1_ADON)) {
+        return;
+    }
+    const uint8_t channel = ADC1->CSR & 0x0F;
+    uint16_t value = adcInputs[channel];
+    if(ADC1->CR3 & ADC1_CR3_DBUF) {
+        const bool scan = ADC1->CR2 & ADC1_CR2_SCAN;
+        const uint8_t count = scan ? channel + 1 : 10;
+        for(uint8_t i = 0; i < count; ++i) {
+            value = adcInputs[scan ? i : channel];
+            memcpy((uint8_t*)&ADC1->DB0RH + i * 2, &value, sizeof(value));
+        }
+    }
+    memcpy((uint8_t*)&ADC1->DRH, &value, sizeof(value));
+    ADC1->CSR |= ADC1_CSR_EOC;
+    Poll();
+}
+
+void Halt()
+{
+    if(AWU->CSR & AWU_CSR_AWUEN) {
+        AWU->CSR |= AWU_CSR_AWUF;
+        Raise(AWU_vector);
+        AWU->CSR &= ~AWU_CSR_AWUF; // cleared by the CSR read of the handler
+    }
+    Poll();
+}
+
+void Jump(uint16_t addr)
+{
+    if(jumpCallback) {
+        jumpCallback(addr);
+    }
+}
+
+void SetJumpCallback(JumpCallback cb)
+{
+    jumpCallback = cb;
+}
+
+} // Host
+} // Mcudrv
+
+#endif // MCUDRV_HOST
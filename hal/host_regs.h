@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// Host build support, included by stm8s.h when MCUDRV_HOST is defined (GCC/Clang, Linux).
+// Peripheral structs are mapped onto a simulated register file (see MCUDRV_PERIPH), IAR keywords and
+// intrinsics are replaced. Register side effects which plain memory can't show (flags raised by
+// hardware, read/write-to-clear) are modeled by the hooks below, interrupts are dispatched to the
+// handlers attached with AttachIsr:
+// - GPIO: IDR follows ODR for outputs and SetInput for inputs, ODR changes are reported by PinCallback;
+// - UART: bytes are injected with UartReceive (with error flags if needed) and the transmitted ones are
+//   reported by UartTxCallback;
+// - TIM1/TIM2/TIM3/TIM4: up-counting with prescaler, update and compare flags, by AdvanceTimers;
+//   input capture events are injected with TimerCapture;
+// - ADC1: AdcConvert takes the values set by SetAdcInput;
+// - AWU: Active-halt (__halt) ends with the AWU interrupt if the AWU is enabled, LSI is always ready;
+// - far jump to another program (bootloader to application) is reported by JumpCallback.
+// Word registers read by the HAL as uint16_t (ADC data) are stored in host byte order.
+// PWM outputs and the rest of peripherals are plain memory.
+
+#pragma once
+#ifndef HOST_REGS_H
+#define HOST_REGS_H
+
+#include <stdint.h>
+
+#ifndef __UINT16_T_MAX__
+#define __UINT16_T_MAX__ 0xFFFF
+#endif
+#define __interrupt
+#define __ramfunc
+#define __no_init
+
+typedef uint8_t __istate_t;
+
+namespace Mcudrv {
+namespace Host {
+enum
+{
+    RegFileBase = 0x4000, // EEPROM, option bytes, peripherals, CPU/ITC registers
+    RegFileSize = 0x4000
+};
+extern uint8_t regFile[RegFileSize];
+extern bool irqEnabled;
+extern unsigned long nopCount; // __no_operation() calls, delays shorter than a loop are made of them
+
+inline uint8_t* RegAddress(uint16_t addr)
+{
+    return &regFile[addr - RegFileBase];
+}
+
+typedef void (*Isr)();
+typedef void (*PinCallback)(uint8_t portId, uint8_t odr, uint8_t changed);
+typedef void (*UartTxCallback)(uint8_t c);
+typedef void (*JumpCallback)(uint16_t addr);
+
+// Registers to reset values, handlers and queued data are dropped
+void Reset();
+void AttachIsr(uint8_t vector, Isr isr);
+// Mirrors outputs to inputs and runs the handlers of pending enabled interrupts
+void Poll();
+
+void SetInput(uint8_t portId, uint8_t mask, bool level);
+void SetPinCallback(PinCallback cb);
+template<typename Pin>
+void SetPin(bool level)
+{
+    SetInput(Pin::Port::id, Pin::mask, level);
+}
+
+// Queues a byte to the receiver, false if the queue is full.
+// errors: SR flags raised with the byte (UART1_SR_PE, FE, NF, OR)
+bool UartReceive(uint8_t c, uint8_t errors = 0);
+void SetUartTxCallback(UartTxCallback cb);
+// Called by the Uart on DR write/read
+void UartWritten(uint16_t base);
+void UartRead(uint16_t base);
+
+// Counts ticks of fMASTER on all enabled timers, interrupts are dispatched as they occur
+void AdvanceTimers(uint32_t ticks);
+// Edge on the input of a channel in capture mode: the counter is latched to CCRx and CCxIF (CCxOF) is set
+void TimerCapture(uint16_t base, uint8_t ch);
+// Called by the timers on a capture register read
+void CaptureRead(uint16_t base, uint8_t ch);
+
+void SetAdcInput(uint8_t channel, uint16_t value);
+// Completes the conversion(s) configured in ADC1 registers
+void AdcConvert();
+
+// Active-halt: the AWU interrupt is raised if the AWU is on, then the pending ones are served
+void Halt();
+
+// Replaces the jump to the code at addr, returns if no callback is set
+void Jump(uint16_t addr);
+void SetJumpCallback(JumpCallback cb);
+} // Host
+} // Mcudrv
+
+inline void __enable_interrupt()
+{
+    Mcudrv::Host::irqEnabled = true;
+}
+inline void __disable_interrupt()
+{
+    Mcudrv::Host::irqEnabled = false;
+}
+inline __istate_t __get_interrupt_state()
+{
+    return Mcudrv::Host::irqEnabled;
+}
+inline void __set_interrupt_state(__istate_t state)
+{
+    Mcudrv::Host::irqEnabled = state;
+}
+inline void __no_operation()
+{
+    ++Mcudrv::Host::nopCount;
+}
+inline void __trap()
+{ }
+// WFI and HALT enable interrupts
+inline void __wait_for_interrupt()
+{
+    Mcudrv::Host::irqEnabled = true;
+    Mcudrv::Host::Poll();
+}
+inline void __halt()
+{
+    Mcudrv::Host::irqEnabled = true;
+    Mcudrv::Host::Halt();
+}
+
+#endif // HOST_REGS_H
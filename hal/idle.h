@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+#ifndef IDLE_H
+#define IDLE_H
+
+#include "gpio.h"
+#include "iwdg.h"
+#include "stm8s.h"
+#include "uart.h"
+
+// EXTI vector of the port of the RX wakeup pin, PD6 (UART RX) or PD5 (single wire UART1) by default
+#ifndef IDLE_WAKEUP_VECTOR
+#define IDLE_WAKEUP_VECTOR EXTI3_vector
+#endif
+
+namespace Mcudrv {
+namespace Power {
+// Auto wakeup from Active-halt, clocked by LSI
+class Awu
+{
+public:
+    static const uint32_t LsiFreq = 128000UL;
+    static const uint32_t CyclesMax = 64UL << 11; // 1.024s, AWUTB = 12, APRDIV = 64
+    static void Init()
+    {
+        CLK->ICKR |= CLK_ICKR_LSIEN;
+        while(!(CLK->ICKR & CLK_ICKR_LSIRDY))
+            ;
+    }
+    // Period = 2^(AWUTB - 1) * APRDIV / fLSI, not longer than requested
+    static void Start(uint32_t lsiCycles)
+    {
+        uint8_t tb = 1;
+        while(lsiCycles > (64UL << (tb - 1)) && tb < 12) {
+            ++tb;
+        }
+        uint32_t div = lsiCycles >> (tb - 1);
+        if(div > 64) {
+            div = 64;
+        }
+        AWU->APR = div > 2 ? uint8_t(div - 2) : 0;
+        AWU->TBR = tb;
+        AWU->CSR = AWU_CSR_AWUEN;
+    }
+    static void Stop()
+    {
+        AWU->CSR = 0;
+        AWU->TBR = 0; // no AWU counter consumption in Halt
+    }
+};
+
+// Busy predicates for the idle manager: Active-halt stops fMASTER and peripherals with it
+template<typename Uart>
+struct UartTxActive
+{
+    static bool IsActive()
+    {
+        return !Uart::IsEvent(Uarts::EvTxComplete);
+    }
+};
+// Receiver is on, a byte arriving in halt would be lost
+template<typename Uart>
+struct UartRxEnabled
+{
+    static bool IsActive()
+    {
+        return Uart::Regs()->CR2 & UART1_CR2_REN;
+    }
+};
+struct NeverActive
+{
+    static bool IsActive()
+    {
+        return false;
+    }
+};
+struct AdcActive
+{
+    static bool IsActive()
+    {
+        return ADC1->CR1 & ADC1_CR1_ADON;
+    }
+};
+// Timers are running, PWM outputs (e.g. dimming) would freeze
+struct PwmActive
+{
+    static bool IsActive()
+    {
+        return (TIM1->CR1 & TIM1_CR1_CEN) || (TIM2->CR1 & TIM2_CR1_CEN)
+#ifdef TIM3
+            || (TIM3->CR1 & TIM3_CR1_CEN)
+#endif
+            ;
+    }
+};
+
+namespace Internal {
+template<typename... Busy>
+struct AnyActive;
+template<>
+struct AnyActive<>
+{
+    static bool IsActive()
+    {
+        return false;
+    }
+};
+template<typename First, typename... Rest>
+struct AnyActive<First, Rest...>
+{
+    static bool IsActive()
+    {
+        return First::IsActive() || AnyActive<Rest...>::IsActive();
+    }
+};
+} // Internal
+
+// Longest sleep in ticks that keeps the watchdog fed, for IdleManager MaxSleepTicks: 3/4 of the IWDG
+// timeout, the rest is left for the wakeup and the main loop pass up to the next refresh
+template<Iwdg::Period period, uint16_t TickFreq>
+struct WatchdogSleepTicks
+{
+    enum
+    {
+        value = uint32_t(Iwdg::Timeout<period>::ms) * 3 / 4 * TickFreq / 1000
+    };
+};
+
+// Idle manager, Sleep() is called when the main loop iteration has nothing to do.
+// Clock: tick source with TicksToNext()/Advance() (SoftTimers::TimerWheel), ticked TickFreq times a second.
+// WFI is entered when callbacks aren't pending, any interrupt wakes the CPU.
+// Active-halt is entered if allowed by SetHaltEnabled() and none of Busy::IsActive() (any class with
+// static bool IsActive(): Wake, predicates above). The AWU wakes the CPU before the next deadline, the
+// slept ticks are accounted to the clock. Sleeps are limited to ~1s (AWU) and MaxSleepTicks (keep it
+// below the IWDG period with WatchdogSleepTicks, it's refreshed before halt), halt isn't used if
+// MaxSleepTicks is shorter than a halt takes.
+// Only Clock is advanced by the slept ticks, any other per tick work (e.g. a timer ISR driven
+// sampling or fading) is skipped for them.
+// UART can't receive in Halt: WakePin (RX pin) falling edge wakes the CPU by EXTI, the byte in
+// progress is lost. Use UartRxEnabled as a busy predicate if the protocol can't afford that (for Wake
+// the master would have to precede frames with an extra FEND). The time slept before an early wakeup
+// isn't accounted.
+template<typename Clock, uint16_t TickFreq, typename WakePin, uint16_t MaxSleepTicks = 0xFFFF, typename... Busy>
+class IdleManager
+{
+private:
+    static const uint16_t LsiPerTick = Awu::LsiFreq / TickFreq;
+    static const uint16_t AwuMaxTicks = Awu::CyclesMax / LsiPerTick;
+    static const uint16_t MinHaltTicks = 2; // sleep ends a tick before the deadline
+    static_assert(IDLE_WAKEUP_VECTOR == EXTI0_vector + WakePin::Port::id, "Wrong IDLE_WAKEUP_VECTOR for WakePin");
+    static bool haltEnabled_;
+    static volatile bool awuWakeup_;
+
+    static void Halt(uint16_t ticks)
+    {
+        ticks -= 1;
+        if(ticks > AwuMaxTicks) {
+            ticks = AwuMaxTicks;
+        }
+        if(ticks > MaxSleepTicks) {
+            ticks = MaxSleepTicks;
+        }
+        awuWakeup_ = false;
+        Awu::Start(uint32_t(ticks) * LsiPerTick);
+        WakePin::template SetConfig<GpioBase::In_Pullup_int>();
+        Iwdg::Refresh();
+        __halt(); // interrupts are enabled by HALT
+        __disable_interrupt();
+        Awu::Stop();
+        WakePin::template SetConfig<GpioBase::In_Pullup>();
+        if(awuWakeup_) {
+            Clock::Advance(ticks);
+        }
+        __enable_interrupt();
+    }
+public:
+    _Pragma(VECTOR_ID(AWU_vector)) __interrupt static void AwuISR()
+    {
+        (void)AWU->CSR; // clears AWUF
+        awuWakeup_ = true;
+    }
+    _Pragma(VECTOR_ID(IDLE_WAKEUP_VECTOR)) __interrupt static void WakePinISR()
+    {
+        WakePin::template SetConfig<GpioBase::In_Pullup>();
+    }
+
+    static void Init()
+    {
+        Awu::Init();
+        CLK->ICKR |= CLK_ICKR_SWUAH;  // main regulator off in Active-halt
+        FLASH->CR1 |= FLASH_CR1_AHALT; // flash in power-down in Active-halt
+        __istate_t state = __get_interrupt_state();
+        __disable_interrupt();
+        Exti::SetExtIntMode<static_cast<Exti::Port>(WakePin::Port::id), Exti::FallingEdge>();
+        __set_interrupt_state(state);
+    }
+    static void SetHaltEnabled(bool enable)
+    {
+        haltEnabled_ = enable;
+    }
+    static void Sleep()
+    {
+        __disable_interrupt();
+        const uint16_t ticks = Clock::TicksToNext();
+        if(!ticks) {
+            __enable_interrupt();
+            return;
+        }
+        if(haltEnabled_ && ticks >= MinHaltTicks && MaxSleepTicks >= MinHaltTicks &&
+           !Internal::AnyActive<Busy...>::IsActive()) {
+            Halt(ticks);
+        }
+        else {
+            __wait_for_interrupt(); // interrupts are enabled by WFI
+        }
+    }
+};
+
+template<typename Clock, uint16_t TickFreq, typename WakePin, uint16_t MaxSleepTicks, typename... Busy>
+bool IdleManager<Clock, TickFreq, WakePin, MaxSleepTicks, Busy...>::haltEnabled_;
+template<typename Clock, uint16_t TickFreq, typename WakePin, uint16_t MaxSleepTicks, typename... Busy>
+volatile bool IdleManager<Clock, TickFreq, WakePin, MaxSleepTicks, Busy...>::awuWakeup_;
+
+} // Power
+} // Mcudrv
+
+#endif // IDLE_H
@@ -160,15 +160,22 @@ public:
         OwPin::Set();
         OwPin::template SetConfig<GpioBase::Out_OpenDrain_fast>();
     }
-// return true if presence exist
+// Reset pulse and presence sample (550 us), return true if presence exist.
+// The bus needs 410 us of recovery before the next slot, the caller waits it out
+// (e.g. PT_DELAY for 2 ticks, at least one full tick), Reset() does it by delay.
 #pragma optimize = speed
-    static bool Reset()
+    static bool ResetPulse()
     {
         OwPin::Clear();
         delay_us<480>();
         OwPin::Set();
         delay_us<70>();
-        bool result = !OwPin::IsSet();
+        return !OwPin::IsSet();
+    }
+// return true if presence exist
+    static bool Reset()
+    {
+        const bool result = ResetPulse();
         delay_us<410>();
         return result;
     }
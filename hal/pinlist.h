@@ -28,342 +28,378 @@
 
 namespace Mcudrv {
 
-template<typename S0 = Nullpin,
-         typename S1 = Nullpin,
-         typename S2 = Nullpin,
-         typename S3 = Nullpin,
-         typename S4 = Nullpin,
-         typename S5 = Nullpin,
-         typename S6 = Nullpin,
-         typename S7 = Nullpin>
-struct Pinlist : GpioBase
+namespace Internal {
+template<typename... Pins>
+struct PinTypeList
+{ };
+
+template<typename L, typename R>
+struct ConcatPins;
+template<typename... L, typename... R>
+struct ConcatPins<PinTypeList<L...>, PinTypeList<R...> >
+{
+    typedef PinTypeList<L..., R...> type;
+};
+
+// Count pins starting from First on the same port
+template<typename First, uint8_t Count>
+struct PinRange
+{
+    typedef typename ConcatPins<PinTypeList<First>,
+                                typename PinRange<TPin<typename First::Port, (First::mask << 1) & 0xFF>,
+                                                  Count - 1>::type>::type type;
+};
+template<typename First>
+struct PinRange<First, 0>
+{
+    typedef PinTypeList<> type;
+};
+
+template<typename Port, typename... Pins>
+struct HasPort
+{
+    static const bool value = false;
+};
+template<typename Port, typename Head, typename... Tail>
+struct HasPort<Port, Head, Tail...>
+{
+    static const bool value = stdx::is_same<Port, typename Head::Port>::value || HasPort<Port, Tail...>::value;
+};
+
+// Port bits of the pins located on Port at the Shift distance (port bit - value bit)
+template<typename Port, int Shift, uint8_t Index, typename... Pins>
+struct ShiftMask
 {
     enum
     {
-        size = S0::mask == 0   ? 0
-               : S1::mask == 0 ? 1
-               : S2::mask == 0 ? 2
-               : S3::mask == 0 ? 3
-               : S4::mask == 0 ? 4
-               : S5::mask == 0 ? 5
-               : S6::mask == 0 ? 6
-               : S7::mask == 0 ? 7
-                               : 8
+        value = 0
     };
-    static uint8_t ReadODR()
-    {
-        uint8_t value = 0;
-        if(S0::IsODRSet())
-            value |= 0x01;
-        if(S1::IsODRSet())
-            value |= 0x02;
-        if(S2::IsODRSet())
-            value |= 0x04;
-        if(S3::IsODRSet())
-            value |= 0x08;
-        if(S4::IsODRSet())
-            value |= 0x10;
-        if(S5::IsODRSet())
-            value |= 0x20;
-        if(S6::IsODRSet())
-            value |= 0x40;
-        if(S7::IsODRSet())
-            value |= 0x80;
-        return value;
-    }
-    static uint8_t Read()
-    {
-        uint8_t value = 0;
-        if(S0::IsSet())
-            value |= 0x01;
-        if(S1::IsSet())
-            value |= 0x02;
-        if(S2::IsSet())
-            value |= 0x04;
-        if(S3::IsSet())
-            value |= 0x08;
-        if(S4::IsSet())
-            value |= 0x10;
-        if(S5::IsSet())
-            value |= 0x20;
-        if(S6::IsSet())
-            value |= 0x40;
-        if(S7::IsSet())
-            value |= 0x80;
-        return value;
-    }
-    static void Toggle(uint8_t mask)
-    {
-        if(mask & 0x01)
-            S0::Toggle();
-        if(mask & 0x02)
-            S1::Toggle();
-        if(mask & 0x04)
-            S2::Toggle();
-        if(mask & 0x08)
-            S3::Toggle();
-        if(mask & 0x10)
-            S4::Toggle();
-        if(mask & 0x20)
-            S5::Toggle();
-        if(mask & 0x40)
-            S6::Toggle();
-        if(mask & 0x80)
-            S7::Toggle();
+};
+template<typename Port, int Shift, uint8_t Index, typename Head, typename... Tail>
+struct ShiftMask<Port, Shift, Index, Head, Tail...>
+{
+    enum
+    {
+        value = (stdx::is_same<Port, typename Head::Port>::value && int(Head::position) - int(Index) == Shift
+                   ? Head::mask
+                   : 0) |
+                ShiftMask<Port, Shift, Index + 1, Tail...>::value
+    };
+};
+
+template<int Shift, bool Left = (Shift >= 0)>
+struct Shifter
+{
+    template<typename T>
+    static T ToPort(T value)
+    {
+        return value << Shift;
     }
-    static void Set(uint8_t mask)
-    {
-        if(mask & 0x01)
-            S0::Set();
-        if(mask & 0x02)
-            S1::Set();
-        if(mask & 0x04)
-            S2::Set();
-        if(mask & 0x08)
-            S3::Set();
-        if(mask & 0x10)
-            S4::Set();
-        if(mask & 0x20)
-            S5::Set();
-        if(mask & 0x40)
-            S6::Set();
-        if(mask & 0x80)
-            S7::Set();
+    template<typename T>
+    static T FromPort(T value)
+    {
+        return value >> Shift;
     }
-    static void Clear(uint8_t mask)
-    {
-        if(mask & 0x01)
-            S0::Clear();
-        if(mask & 0x02)
-            S1::Clear();
-        if(mask & 0x04)
-            S2::Clear();
-        if(mask & 0x08)
-            S3::Clear();
-        if(mask & 0x10)
-            S4::Clear();
-        if(mask & 0x20)
-            S5::Clear();
-        if(mask & 0x40)
-            S6::Clear();
-        if(mask & 0x80)
-            S7::Clear();
+};
+template<int Shift>
+struct Shifter<Shift, false>
+{
+    template<typename T>
+    static T ToPort(T value)
+    {
+        return value >> -Shift;
     }
-    static void Write(uint8_t value)
-    {
-        if(value & 0x01)
-            S0::Set();
-        else
-            S0::Clear();
-        if(value & 0x02)
-            S1::Set();
-        else
-            S1::Clear();
-        if(value & 0x04)
-            S2::Set();
-        else
-            S2::Clear();
-        if(value & 0x08)
-            S3::Set();
-        else
-            S3::Clear();
-        if(value & 0x10)
-            S4::Set();
-        else
-            S4::Clear();
-        if(value & 0x20)
-            S5::Set();
-        else
-            S5::Clear();
-        if(value & 0x40)
-            S6::Set();
-        else
-            S6::Clear();
-        if(value & 0x80)
-            S7::Set();
-        else
-            S7::Clear();
+    template<typename T>
+    static T FromPort(T value)
+    {
+        return value << -Shift;
     }
+};
+
+// Pins of the list located on Port, Index is the bit number of the first pin in the value.
+// Pins at the same distance between value and port bits (contiguous runs and alike) are moved
+// with a single shift-and-mask, led by the lowest pin of the run.
+template<typename Port, typename DataT, uint8_t Index, typename All, typename... Pins>
+struct PortPins
+{
+    enum
+    {
+        Mask = 0
+    };
+    template<uint32_t value>
+    struct ToPortConst
+    {
+        enum
+        {
+            value_ = 0
+        };
+    };
 #pragma inline = forced
-    template<Cfg cfg>
-    static void SetConfig()
+    static uint8_t ToPort(DataT)
     {
-        S0::template SetConfig<cfg>();
-        S1::template SetConfig<cfg>();
-        S2::template SetConfig<cfg>();
-        S3::template SetConfig<cfg>();
-        S4::template SetConfig<cfg>();
-        S5::template SetConfig<cfg>();
-        S6::template SetConfig<cfg>();
-        S7::template SetConfig<cfg>();
+        return 0;
     }
 #pragma inline = forced
-    template<uint8_t mask_, Cfg cfg>
-    static void SetConfig()
+    static DataT FromPort(uint8_t)
     {
-        if(mask_ & 0x01)
-            S0::template SetConfig<cfg>();
-        if(mask_ & 0x02)
-            S1::template SetConfig<cfg>();
-        if(mask_ & 0x04)
-            S2::template SetConfig<cfg>();
-        if(mask_ & 0x08)
-            S3::template SetConfig<cfg>();
-        if(mask_ & 0x10)
-            S4::template SetConfig<cfg>();
-        if(mask_ & 0x20)
-            S5::template SetConfig<cfg>();
-        if(mask_ & 0x40)
-            S6::template SetConfig<cfg>();
-        if(mask_ & 0x80)
-            S7::template SetConfig<cfg>();
+        return 0;
     }
 };
-
-template<uint8_t seq>
-struct SequenceOf
+template<typename Port, typename DataT, uint8_t Index, typename... All, typename Head, typename... Tail>
+struct PortPins<Port, DataT, Index, PinTypeList<All...>, Head, Tail...>
 {
+    typedef PortPins<Port, DataT, Index + 1, PinTypeList<All...>, Tail...> Next;
+    typedef Shifter<int(Head::position) - int(Index)> Shift;
     enum
     {
-        value = seq
+        Match = stdx::is_same<Port, typename Head::Port>::value && Head::mask != 0,
+        PinMask = Match ? Head::mask : 0,
+        RunMask = Match ? ShiftMask<Port, int(Head::position) - int(Index), 0, All...>::value : 0,
+        Leader = Match && (RunMask & -RunMask) == PinMask,
+        Mask = PinMask | Next::Mask
+    };
+    template<uint32_t value>
+    struct ToPortConst
+    {
+        enum
+        {
+            value_ = ((value >> Index) & 0x01 ? PinMask : 0) | Next::template ToPortConst<value>::value_
+        };
     };
+#pragma inline = forced
+    static uint8_t ToPort(DataT value)
+    {
+        return (Leader ? Shift::ToPort(value) & RunMask : 0) | Next::ToPort(value);
+    }
+#pragma inline = forced
+    static DataT FromPort(uint8_t portValue)
+    {
+        return (Leader ? Shift::FromPort(DataT(portValue & RunMask)) : 0) | Next::FromPort(portValue);
+    }
 };
 
-template<typename First, uint8_t Seq>
-struct Pinlist<First, SequenceOf<Seq> > : GpioBase
+// Walks the pins, the first pin of every port performs a single access for all pins on that port
+template<typename DataT, typename All, typename Done, typename... Rest>
+struct PortGroups;
+template<typename DataT, typename... All, typename... Done>
+struct PortGroups<DataT, PinTypeList<All...>, PinTypeList<Done...> >
 {
-    typedef typename First::Port Port;
-    enum
+#pragma inline = forced
+    static DataT Read()
     {
-        OFFSET = First::position,
-        MASK = stdx::NumberToMask<Seq>::value << OFFSET,
-        SIZE = Seq
-    };
+        return 0;
+    }
 #pragma inline = forced
-    static uint16_t ReadODR()
+    static DataT ReadODR()
     {
-        return (Port::ReadODR() & MASK) >> OFFSET;
+        return 0;
     }
 #pragma inline = forced
-    static uint16_t Read()
+    static void Write(DataT)
+    { }
+#pragma inline = forced
+    static void Set(DataT)
+    { }
+#pragma inline = forced
+    static void Clear(DataT)
+    { }
+#pragma inline = forced
+    static void Toggle(DataT)
+    { }
+#pragma inline = forced
+    template<uint32_t mask, GpioBase::Cfg cfg>
+    static void SetConfig()
+    { }
+};
+template<typename DataT, typename... All, typename... Done, typename Head, typename... Tail>
+struct PortGroups<DataT, PinTypeList<All...>, PinTypeList<Done...>, Head, Tail...>
+{
+    typedef PortGroups<DataT, PinTypeList<All...>, PinTypeList<Done..., Head>, Tail...> Next;
+    typedef typename Head::Port Port;
+    typedef PortPins<Port, DataT, 0, PinTypeList<All...>, All...> Group;
+    enum
+    {
+        Leader = !HasPort<Port, Done...>::value && Group::Mask != 0
+    };
+#pragma inline = forced
+    static DataT Read()
     {
-        return (Port::Read() & MASK) >> OFFSET;
+        return (Leader ? Group::FromPort(Port::Read()) : 0) | Next::Read();
     }
 #pragma inline = forced
-    static void Write(uint16_t value)
+    static DataT ReadODR()
     {
-        value = (value << OFFSET) & MASK;
-        Port::ClearAndSet(~value & MASK, value);
+        return (Leader ? Group::FromPort(Port::ReadODR()) : 0) | Next::ReadODR();
     }
 #pragma inline = forced
-    template<uint8_t mask, Cfg cfg>
-    static void SetConfig()
+    static void Write(DataT value)
     {
-        Port::template SetConfig<(uint8_t)(mask << OFFSET), cfg>();
+        if(Leader) {
+            Port::ClearAndSet(Group::Mask, Group::ToPort(value));
+        }
+        Next::Write(value);
     }
 #pragma inline = forced
-    template<Cfg cfg>
-    static void SetConfig()
+    static void Set(DataT mask)
     {
-        Port::template SetConfig<MASK, cfg>();
+        if(Leader) {
+            Port::Set(Group::ToPort(mask));
+        }
+        Next::Set(mask);
     }
 #pragma inline = forced
-    static void Toggle(uint8_t mask)
+    static void Clear(DataT mask)
     {
-        Port::Toggle(mask << OFFSET);
+        if(Leader) {
+            Port::Clear(Group::ToPort(mask));
+        }
+        Next::Clear(mask);
     }
 #pragma inline = forced
-    static void Set(uint8_t mask)
+    static void Toggle(DataT mask)
     {
-        Port::Set(mask << OFFSET);
+        if(Leader) {
+            Port::Toggle(Group::ToPort(mask));
+        }
+        Next::Toggle(mask);
     }
 #pragma inline = forced
-    static void Clear(uint8_t mask)
+    template<uint32_t mask, GpioBase::Cfg cfg>
+    static void SetConfig()
     {
-        Port::Clear(mask << OFFSET);
+        enum
+        {
+            PortMask = Group::template ToPortConst<mask>::value_
+        };
+        if(Leader && PortMask != 0) {
+            Port::template SetConfig<PortMask, cfg>();
+        }
+        Next::template SetConfig<mask, cfg>();
     }
 };
 
-// Combines up to 4 linear pin ranges to the single virtual port,
-// e.g (Pc3, Pc4, Pc5, Pd0, Pd1, Pd2) sequence could be defined as PinSequence<Pc3, 3, Pd0, 3>
-template<typename T1,
-         uint8_t Seq1,
-         typename T2 = Nullpin,
-         uint8_t Seq2 = 0,
-         typename T3 = Nullpin,
-         uint8_t Seq3 = 0,
-         typename T4 = Nullpin,
-         uint8_t Seq4 = 0>
-class PinSequence : GpioBase
+template<typename... Pins>
+struct CountPins
+{
+    enum
+    {
+        value = 0
+    };
+};
+template<typename Head, typename... Tail>
+struct CountPins<Head, Tail...>
+{
+    enum
+    {
+        value = (Head::mask != 0 ? 1 : 0) + CountPins<Tail...>::value
+    };
+};
+
+template<typename List>
+struct PinlistFromList;
+} // Internal
+
+// Virtual port of up to 32 arbitrary pins, bit N of the value is the Nth pin.
+// Pins are grouped by port at compile time, so every port is accessed once per operation
+// (one read or one read-modify-write) whatever the order of pins is. Within a port, pins keeping
+// the same distance between value and port bits (e.g. contiguous runs) take one shift-and-mask.
+template<typename... Pins>
+struct Pinlist : GpioBase
 {
+    static_assert(sizeof...(Pins) <= 32, "Pinlist is limited to 32 pins");
+    typedef typename stdx::SelectSize<sizeof...(Pins)>::type DataT;
 private:
-    typedef Pinlist<T1, SequenceOf<Seq1> > Pinlist1;
-    typedef Pinlist<T2, SequenceOf<Seq2> > Pinlist2;
-    typedef Pinlist<T3, SequenceOf<Seq3> > Pinlist3;
-    typedef Pinlist<T4, SequenceOf<Seq4> > Pinlist4;
+    typedef Internal::PortGroups<DataT, Internal::PinTypeList<Pins...>, Internal::PinTypeList<>, Pins...> Groups;
 public:
+    enum
+    {
+        size = Internal::CountPins<Pins...>::value
+    };
 #pragma inline = forced
-    static uint16_t ReadODR()
+    static DataT ReadODR()
     {
-        return Pinlist1::ReadODR() | Pinlist2::ReadODR() << Seq1 | Pinlist3::ReadODR() << Seq2 |
-               Pinlist4::ReadODR() << Seq3;
+        return Groups::ReadODR();
     }
 #pragma inline = forced
-    static uint16_t Read()
+    static DataT Read()
     {
-        return Pinlist1::Read() | Pinlist2::Read() << Seq1 | Pinlist3::Read() << Seq2 | Pinlist4::Read() << Seq3;
+        return Groups::Read();
     }
 #pragma inline = forced
-    static void Write(uint16_t value)
+    static void Toggle(DataT mask)
     {
-        Pinlist1::Write(value);
-        Pinlist2::Write(value >> Seq1);
-        Pinlist3::Write(value >> Seq2);
-        Pinlist4::Write(value >> Seq3);
+        Groups::Toggle(mask);
     }
 #pragma inline = forced
-    static void Clear(uint16_t value)
+    static void Set(DataT mask)
     {
-        Pinlist1::Clear(value);
-        Pinlist2::Clear(value >> Seq1);
-        Pinlist3::Clear(value >> Seq2);
-        Pinlist4::Clear(value >> Seq3);
+        Groups::Set(mask);
     }
 #pragma inline = forced
-    static void Set(uint16_t value)
+    static void Clear(DataT mask)
     {
-        Pinlist1::Set(value);
-        Pinlist2::Set(value >> Seq1);
-        Pinlist3::Set(value >> Seq2);
-        Pinlist4::Set(value >> Seq3);
+        Groups::Clear(mask);
     }
 #pragma inline = forced
-    static void Toggle(uint16_t value)
+    static void Write(DataT value)
     {
-        Pinlist1::Toggle(value);
-        Pinlist2::Toggle(value >> Seq1);
-        Pinlist3::Toggle(value >> Seq2);
-        Pinlist4::Toggle(value >> Seq3);
+        Groups::Write(value);
     }
 #pragma inline = forced
-    template<uint8_t mask, Cfg cfg>
+    template<Cfg cfg>
     static void SetConfig()
     {
-        Pinlist1::template SetConfig<static_cast<uint8_t>(mask), cfg>();
-        Pinlist2::template SetConfig<static_cast<uint8_t>(mask >> Seq1), cfg>();
-        Pinlist3::template SetConfig<static_cast<uint8_t>(mask >> Seq2), cfg>();
-        Pinlist4::template SetConfig<static_cast<uint8_t>(mask >> Seq3), cfg>();
+        Groups::template SetConfig<0xFFFFFFFFUL, cfg>();
     }
 #pragma inline = forced
-    template<Cfg cfg>
+    template<uint32_t mask_, Cfg cfg>
     static void SetConfig()
     {
-        Pinlist1::template SetConfig<cfg>();
-        Pinlist2::template SetConfig<cfg>();
-        Pinlist3::template SetConfig<cfg>();
-        Pinlist4::template SetConfig<cfg>();
+        Groups::template SetConfig<mask_, cfg>();
     }
 };
 
+namespace Internal {
+template<typename... Pins>
+struct PinlistFromList<PinTypeList<Pins...> >
+{
+    typedef Pinlist<Pins...> type;
+};
+} // Internal
+
+template<uint8_t seq>
+struct SequenceOf
+{
+    enum
+    {
+        value = seq
+    };
+};
+
+// Seq pins of the same port starting from First
+template<typename First, uint8_t Seq>
+struct Pinlist<First, SequenceOf<Seq> > : Internal::PinlistFromList<typename Internal::PinRange<First, Seq>::type>::type
+{
+    static_assert(First::position + Seq <= 8, "Sequence exceeds the port");
+};
+
+// Combines up to 4 linear pin ranges to the single virtual port,
+// e.g (Pc3, Pc4, Pc5, Pd0, Pd1, Pd2) sequence could be defined as PinSequence<Pc3, 3, Pd0, 3>
+template<typename T1,
+         uint8_t Seq1,
+         typename T2 = Nullpin,
+         uint8_t Seq2 = 0,
+         typename T3 = Nullpin,
+         uint8_t Seq3 = 0,
+         typename T4 = Nullpin,
+         uint8_t Seq4 = 0>
+class PinSequence
+  : public Internal::PinlistFromList<typename Internal::ConcatPins<
+      typename Internal::ConcatPins<typename Internal::PinRange<T1, Seq1>::type,
+                                    typename Internal::PinRange<T2, Seq2>::type>::type,
+      typename Internal::ConcatPins<typename Internal::PinRange<T3, Seq3>::type,
+                                    typename Internal::PinRange<T4, Seq4>::type>::type>::type>::type
+{ };
+
 } // Mcudrv
 #endif // PINLIST_H
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+#ifndef SOFT_TIMER_H
+#define SOFT_TIMER_H
+
+#include "stm8s.h"
+
+namespace Mcudrv {
+namespace SoftTimers {
+enum Mode
+{
+    OneShot,
+    Periodic
+};
+typedef void (*Callback)();
+
+// Software timers on a hierarchical timing wheel: 4 levels of 16 slots cover the 16-bit tick range,
+// so start, stop and expiry are O(1) regardless of the number of running timers. A timer waits in
+// the slot of its most significant differing tick nibble and cascades down as the time comes.
+// Tick() is called from a periodic ISR (TIM4 update in Wake), expired timers are queued and their
+// callbacks are run by Dispatch() from the main loop. Periodic timers are rearmed on dispatch
+// without drift, missed periods are skipped.
+// Timer ids are 0...TimerCount-1, allocated by the application.
+// Start/Stop may be used from the main loop and from ISRs not preempting the tick ISR.
+template<uint8_t TimerCount>
+class TimerWheel
+{
+private:
+    enum
+    {
+        SlotBits = 4,
+        Slots = 1U << SlotBits,
+        SlotMask = Slots - 1,
+        Levels = 16 / SlotBits,
+        ReadyList = Levels * Slots,
+        ListCount = ReadyList + 1
+    };
+    static_assert(TimerCount && TimerCount < 0xFF, "Wrong timers count");
+    // Links and list numbers are stored +1, 0 is the end of list / not linked
+    struct Timer
+    {
+        uint16_t expire;
+        uint16_t period; // 0 for one-shot
+        Callback callback;
+        uint8_t next;
+        uint8_t prev;
+        uint8_t list;
+    };
+    static Timer timers_[TimerCount];
+    static uint8_t heads_[ListCount];
+    static volatile uint16_t now_;
+
+    static void Link(uint8_t list, uint8_t id)
+    {
+        Timer& t = timers_[id];
+        t.list = list + 1;
+        t.prev = 0;
+        t.next = heads_[list];
+        if(t.next) {
+            timers_[t.next - 1].prev = id + 1;
+        }
+        heads_[list] = id + 1;
+    }
+    static void Unlink(uint8_t id)
+    {
+        Timer& t = timers_[id];
+        if(!t.list) {
+            return;
+        }
+        if(t.prev) {
+            timers_[t.prev - 1].next = t.next;
+        }
+        else {
+            heads_[t.list - 1] = t.next;
+        }
+        if(t.next) {
+            timers_[t.next - 1].prev = t.prev;
+        }
+        t.list = 0;
+    }
+    static void Insert(uint8_t id)
+    {
+        const uint16_t expire = timers_[id].expire;
+        const uint16_t delta = expire - now_;
+        uint8_t list;
+        if(delta < (1U << SlotBits)) {
+            list = expire & SlotMask;
+        }
+        else if(delta < (1U << SlotBits * 2)) {
+            list = Slots + ((expire >> SlotBits) & SlotMask);
+        }
+        else if(delta < (1U << SlotBits * 3)) {
+            list = Slots * 2 + ((expire >> SlotBits * 2) & SlotMask);
+        }
+        else {
+            list = Slots * 3 + (expire >> SlotBits * 3);
+        }
+        Link(list, id);
+    }
+    // Moves the timers of the list to their place relative to current tick, or to the ready list
+    static void Move(uint8_t list, bool expired)
+    {
+        uint8_t ref = heads_[list];
+        heads_[list] = 0;
+        while(ref) {
+            const uint8_t id = ref - 1;
+            ref = timers_[id].next;
+            if(expired) {
+                Link(ReadyList, id);
+            }
+            else {
+                Insert(id);
+            }
+        }
+    }
+
+public:
+    FORCEINLINE
+    static void Tick()
+    {
+        const uint16_t now = ++now_;
+        if(!(now & SlotMask)) {
+            Move(Slots + ((now >> SlotBits) & SlotMask), false);
+            if(!(now & (Slots * Slots - 1))) {
+                Move(Slots * 2 + ((now >> SlotBits * 2) & SlotMask), false);
+                if(!(now & (Slots * Slots * Slots - 1))) {
+                    Move(Slots * 3 + (now >> SlotBits * 3), false);
+                }
+            }
+        }
+        Move(now & SlotMask, true);
+    }
+    // Restarts the timer if it's running, ticks = 0 is treated as 1
+    static void Start(uint8_t id, uint16_t ticks, Callback callback, Mode mode = OneShot)
+    {
+        if(!ticks) {
+            ticks = 1;
+        }
+        __istate_t state = __get_interrupt_state();
+        __disable_interrupt();
+        Unlink(id);
+        Timer& t = timers_[id];
+        t.callback = callback;
+        t.period = mode == Periodic ? ticks : 0;
+        t.expire = now_ + ticks;
+        Insert(id);
+        __set_interrupt_state(state);
+    }
+    // Pending callback is canceled as well
+    static void Stop(uint8_t id)
+    {
+        __istate_t state = __get_interrupt_state();
+        __disable_interrupt();
+        Unlink(id);
+        __set_interrupt_state(state);
+    }
+    static bool IsActive(uint8_t id)
+    {
+        return timers_[id].list;
+    }
+    static uint16_t Now()
+    {
+        __istate_t state = __get_interrupt_state();
+        __disable_interrupt();
+        const uint16_t now = now_;
+        __set_interrupt_state(state);
+        return now;
+    }
+    // Ticks until the nearest expiry, 0 if callbacks are pending, 0xFFFF if no timer is running.
+    // O(TimerCount), intended for the idle path with interrupts disabled.
+    static uint16_t TicksToNext()
+    {
+        if(heads_[ReadyList]) {
+            return 0;
+        }
+        uint16_t next = 0xFFFF;
+        for(uint8_t id = 0; id < TimerCount; ++id) {
+            const Timer& t = timers_[id];
+            if(t.list) {
+                const uint16_t delta = t.expire - now_;
+                if(delta < next) {
+                    next = delta;
+                }
+            }
+        }
+        return next;
+    }
+    // Accounts ticks passed while the tick source was stopped (e.g. in Active-halt)
+    static void Advance(uint16_t ticks)
+    {
+        while(ticks--) {
+            Tick();
+        }
+    }
+    // Runs callbacks of expired timers, returns false if there were none
+    static bool Dispatch()
+    {
+        bool dispatched = false;
+        while(true) {
+            __istate_t state = __get_interrupt_state();
+            __disable_interrupt();
+            const uint8_t ref = heads_[ReadyList];
+            if(!ref) {
+                __set_interrupt_state(state);
+                break;
+            }
+            const uint8_t id = ref - 1;
+            Timer& t = timers_[id];
+            Unlink(id);
+            const Callback callback = t.callback;
+            if(t.period) {
+                const uint16_t late = now_ - t.expire;
+                t.expire += t.period * (late / t.period + 1);
+                Insert(id);
+            }
+            __set_interrupt_state(state);
+            if(callback) {
+                callback();
+            }
+            dispatched = true;
+        }
+        return dispatched;
+    }
+};
+
+template<uint8_t TimerCount>
+typename TimerWheel<TimerCount>::Timer TimerWheel<TimerCount>::timers_[TimerCount];
+template<uint8_t TimerCount>
+uint8_t TimerWheel<TimerCount>::heads_[TimerWheel<TimerCount>::ListCount];
+template<uint8_t TimerCount>
+volatile uint16_t TimerWheel<TimerCount>::now_;
+
+} // SoftTimers
+} // Mcudrv
+
+#endif // SOFT_TIMER_H
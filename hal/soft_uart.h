@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+#ifndef SOFT_UART_H
+#define SOFT_UART_H
+
+#include "circularBuffer.h"
+#include "format.h"
+#include "gpio.h"
+#include "stm8s.h"
+#include "timers.h"
+#include "uart.h"
+
+// Vector of the timer used by SoftUart, TIM3_CAPCOM_CC1IF_vector when Timer3 is used
+#ifndef SOFTUART_VECTOR
+#define SOFTUART_VECTOR TIM2_CAPCOM_CC1IF_vector
+#endif
+
+namespace Mcudrv {
+namespace Uarts {
+namespace Internal {
+// Input capture channel for the RX pin
+template<uint16_t TimerBase, typename Pin>
+struct CaptureChannel;
+template<>
+struct CaptureChannel<TIM2_BaseAddress, Pd4>
+{
+    static const Timers::Channel value = Timers::Ch1;
+};
+template<>
+struct CaptureChannel<TIM2_BaseAddress, Pd3>
+{
+    static const Timers::Channel value = Timers::Ch2;
+};
+template<>
+struct CaptureChannel<TIM2_BaseAddress, Pa3>
+{
+    static const Timers::Channel value = Timers::Ch3;
+};
+template<>
+struct CaptureChannel<TIM3_BaseAddress, Pd2>
+{
+    static const Timers::Channel value = Timers::Ch1;
+};
+template<>
+struct CaptureChannel<TIM3_BaseAddress, Pd0>
+{
+    static const Timers::Channel value = Timers::Ch2;
+};
+} // Internal
+
+// Full duplex 8N1 UART on a general purpose timer (TIM2 or TIM3), the timer is free running at F_CPU
+// and can't be used for anything else.
+// TX: any pin, every bit edge is scheduled by a compare interrupt of the channel not used by RX.
+// RX: timer channel input pin, the start bit falling edge is captured, then the channel is switched
+// to compare mode to sample the bits in the middle.
+template<typename TxPin,
+         typename RxPin,
+         uint16_t TimerBase = TIM2_BaseAddress,
+         BaudRate baud = 9600UL,
+         uint8_t TxBufSize = 16,
+         uint8_t RxBufSize = TxBufSize>
+class SoftUart
+{
+public:
+    struct RxStats
+    {
+        uint16_t frameErr;
+        uint16_t overflow; // bytes dropped because rxbuf_ was full
+    };
+private:
+    typedef SoftUart<TxPin, RxPin, TimerBase, baud, TxBufSize, RxBufSize> Self;
+    typedef T2::Internal::Timer<TimerBase> Timer;
+    static const Timers::Channel RxCh = Internal::CaptureChannel<TimerBase, RxPin>::value;
+    static const Timers::Channel TxCh = RxCh == Timers::Ch1 ? Timers::Ch2 : Timers::Ch1;
+    static const uint16_t BitTicks = F_CPU / baud;
+    static const T2::Ints RxIrq = T2::Ints(T2::IRQ_Ch1 << RxCh);
+    static const T2::Ints TxIrq = T2::Ints(T2::IRQ_Ch1 << TxCh);
+    enum
+    {
+        RxStopBit = 10 // rxBits_ after the start bit and 8 data bits
+    };
+    static_assert(F_CPU / baud < 0x10000UL, "Baudrate is too low for this F_CPU");
+    static_assert(F_CPU / baud >= 100, "Baudrate is too high for this F_CPU");
+    static_assert((TimerBase == TIM2_BaseAddress) == (SOFTUART_VECTOR == TIM2_CAPCOM_CC1IF_vector),
+                  "SOFTUART_VECTOR doesn't match the timer");
+
+    static CircularBuffer<TxBufSize> txbuf_;
+    static CircularBuffer<RxBufSize> rxbuf_;
+    static volatile bool txActive_;
+    static uint16_t txFrame_; // start bit, data, stop bit, LSB first
+    static uint8_t txBits_;
+    static uint8_t rxByte_;
+    static uint8_t rxBits_; // 0 - waiting for the start bit
+    static RxStats rxStats_;
+
+    FORCEINLINE
+    static void ArmCapture()
+    {
+        using namespace T2;
+        Timer::template ChannelDisable<RxCh>();
+        Timer::template SetChannelCfg<RxCh, Input, In_Filt_n4>();
+        Timer::template ChannelEnable<RxCh, ActiveLow>(); // falling edge
+        Timer::ClearIntFlag(RxIrq);
+        rxBits_ = 0;
+    }
+    FORCEINLINE
+    static void ArmSampling(uint16_t edge)
+    {
+        using namespace T2;
+        Timer::template ChannelDisable<RxCh>();
+        Timer::template SetChannelCfg<RxCh, Output, Out_Frozen>();
+        Timer::template WriteCompareWord<RxCh>(edge + BitTicks / 2);
+        Timer::ClearIntFlag(RxIrq);
+    }
+    FORCEINLINE
+    static void StartTx()
+    {
+        txActive_ = true;
+        Timer::template WriteCompareWord<TxCh>(Timer::ReadCounter() + BitTicks);
+        Timer::ClearIntFlag(TxIrq);
+        Timer::EnableInterrupt(TxIrq);
+    }
+    FORCEINLINE
+    static void TxNext()
+    {
+        if(!txBits_) {
+            uint8_t c;
+            if(!txbuf_.Read(c)) {
+                Timer::DisableInterrupt(TxIrq);
+                txActive_ = false;
+                return;
+            }
+            txFrame_ = (uint16_t(c) << 1) | 0x200;
+            txBits_ = 10;
+        }
+        if(txFrame_ & 0x01) {
+            TxPin::Set();
+        }
+        else {
+            TxPin::Clear();
+        }
+        txFrame_ >>= 1;
+        --txBits_;
+        Timer::template WriteCompareWord<TxCh>(Timer::template ReadCompareWord<TxCh>() + BitTicks);
+    }
+    FORCEINLINE
+    static void RxNext()
+    {
+        if(!rxBits_) {
+            ArmSampling(Timer::template ReadCompareWord<RxCh>());
+            rxBits_ = 1;
+            return;
+        }
+        const bool bit = RxPin::IsSet();
+        if(rxBits_ == 1 && bit) { // glitch, not a start bit
+            ArmCapture();
+            return;
+        }
+        if(rxBits_ == RxStopBit) {
+            if(!bit) {
+                ++rxStats_.frameErr;
+            }
+            else if(!rxbuf_.Write(rxByte_)) {
+                ++rxStats_.overflow;
+            }
+            ArmCapture();
+            return;
+        }
+        if(rxBits_ > 1) {
+            rxByte_ = (rxByte_ >> 1) | (bit ? 0x80 : 0);
+        }
+        ++rxBits_;
+        Timer::ClearIntFlag(RxIrq);
+        Timer::template WriteCompareWord<RxCh>(Timer::template ReadCompareWord<RxCh>() + BitTicks);
+    }
+public:
+    enum
+    {
+        TXBUFSIZE = TxBufSize,
+        RXBUFSIZE = RxBufSize
+    };
+
+    static void Init()
+    {
+        using namespace T2;
+        TxPin::Set();
+        TxPin::template SetConfig<GpioBase::Out_PushPull_fast>();
+        RxPin::template SetConfig<GpioBase::In_Pullup>();
+        Timer::Init(Div_1, Default);
+        Timer::WriteAutoReload(0xFFFF);
+        Timer::template SetChannelCfg<TxCh, Output, Out_Frozen>();
+        ArmCapture();
+        Timer::EnableInterrupt(RxIrq);
+        Timer::Enable();
+    }
+
+    static bool Putch(const uint8_t c)
+    {
+        bool st = txbuf_.Write(c);
+        if(!txActive_) {
+            StartTx();
+        }
+        return st;
+    }
+    static uint16_t Putbuf(const uint8_t* buf, uint16_t size)
+    {
+        uint16_t written = txbuf_.Write(buf, size);
+        if(!txActive_) {
+            StartTx();
+        }
+        return written;
+    }
+    static uint16_t Puts(const uint8_t* s)
+    {
+        return Putbuf(s, strlen((const char*)s));
+    }
+    static uint16_t Puts(const char* s)
+    {
+        return Puts((const uint8_t*)s);
+    }
+    // Formatted output, see format.h
+    template<typename... Args>
+    static void Print(const Args&... args)
+    {
+        io::Print<Self>(args...);
+    }
+    static bool IsTxComplete()
+    {
+        return !txActive_;
+    }
+
+    FORCEINLINE
+    static bool Getch(uint8_t& c)
+    {
+        return rxbuf_.Read(c);
+    }
+    FORCEINLINE
+    static void Flush()
+    {
+        rxbuf_.Clear();
+    }
+    static const RxStats& GetRxStats()
+    {
+        return rxStats_;
+    }
+    static void ClearRxStats()
+    {
+        rxStats_ = RxStats();
+    }
+
+    // TX and RX share the vector, both are handled in one pass
+    _Pragma(VECTOR_ID(SOFTUART_VECTOR))
+    __interrupt static void CapComISR()
+    {
+        // compare flag of the TX channel is set on every match, even if TX is idle
+        if(txActive_ && Timer::CheckIntStatus(TxIrq)) {
+            Timer::ClearIntFlag(TxIrq);
+            TxNext();
+        }
+        if(Timer::CheckIntStatus(RxIrq)) {
+            RxNext();
+        }
+    }
+};
+
+template<typename TxPin, typename RxPin, uint16_t TimerBase, BaudRate baud, uint8_t TxBufSize, uint8_t RxBufSize>
+CircularBuffer<TxBufSize> SoftUart<TxPin, RxPin, TimerBase, baud, TxBufSize, RxBufSize>::txbuf_;
+template<typename TxPin, typename RxPin, uint16_t TimerBase, BaudRate baud, uint8_t TxBufSize, uint8_t RxBufSize>
+CircularBuffer<RxBufSize> SoftUart<TxPin, RxPin, TimerBase, baud, TxBufSize, RxBufSize>::rxbuf_;
+template<typename TxPin, typename RxPin, uint16_t TimerBase, BaudRate baud, uint8_t TxBufSize, uint8_t RxBufSize>
+volatile bool SoftUart<TxPin, RxPin, TimerBase, baud, TxBufSize, RxBufSize>::txActive_;
+template<typename TxPin, typename RxPin, uint16_t TimerBase, BaudRate baud, uint8_t TxBufSize, uint8_t RxBufSize>
+uint16_t SoftUart<TxPin, RxPin, TimerBase, baud, TxBufSize, RxBufSize>::txFrame_;
+template<typename TxPin, typename RxPin, uint16_t TimerBase, BaudRate baud, uint8_t TxBufSize, uint8_t RxBufSize>
+uint8_t SoftUart<TxPin, RxPin, TimerBase, baud, TxBufSize, RxBufSize>::txBits_;
+template<typename TxPin, typename RxPin, uint16_t TimerBase, BaudRate baud, uint8_t TxBufSize, uint8_t RxBufSize>
+uint8_t SoftUart<TxPin, RxPin, TimerBase, baud, TxBufSize, RxBufSize>::rxByte_;
+template<typename TxPin, typename RxPin, uint16_t TimerBase, BaudRate baud, uint8_t TxBufSize, uint8_t RxBufSize>
+uint8_t SoftUart<TxPin, RxPin, TimerBase, baud, TxBufSize, RxBufSize>::rxBits_;
+template<typename TxPin, typename RxPin, uint16_t TimerBase, BaudRate baud, uint8_t TxBufSize, uint8_t RxBufSize>
+typename SoftUart<TxPin, RxPin, TimerBase, baud, TxBufSize, RxBufSize>::RxStats
+  SoftUart<TxPin, RxPin, TimerBase, baud, TxBufSize, RxBufSize>::rxStats_;
+
+} // Uarts
+} // Mcudrv
+
+#endif // SOFT_UART_H
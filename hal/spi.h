@@ -118,7 +118,7 @@ public:
 	}
 	static void ClearEvent(Events ev)
 	{
-		SPI->SR = ~ev;
+		MCUDRV_RC_W0(SPI->SR, ev);
 	}
 	static bool IsEvent(Events ev)
 	{
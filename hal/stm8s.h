@@ -81,7 +81,9 @@
 /*                   Library configuration section                            */
 /******************************************************************************/
 /* Check the used compiler */
-#if defined(__CSMC__)
+#if defined(MCUDRV_HOST)
+ #define _HOST_                 /* Host build on the simulated register file, see host_regs.h */
+#elif defined(__CSMC__)
  #define _COSMIC_
 #elif defined(__RCST7__)
  #define _RAISONANCE_
@@ -140,6 +142,14 @@
   /*!< Used with memory Models for code less than 64K */
   #define MEMCPY memcpy
  #endif /* STM8S208 or STM8S207 or STM8S007 or STM8AF62Ax or STM8AF52Ax */
+#elif defined (_HOST_)
+ #define FORCEINLINE
+ #define NOINLINE
+ #define FAR
+ #define NEAR
+ #define TINY
+ #define EEPROM
+ #define CONST  const
 #else /*_IAR_*/
 #ifndef FORCEINLINE
  #define FORCEINLINE _Pragma("inline=forced")
@@ -2609,110 +2619,122 @@ CFG_TypeDef;
 /*                          Peripherals declarations                          */
 /******************************************************************************/
 
+/* Peripheral pointer from its base address, the host build maps it onto the simulated register file.
+   MCUDRV_RC_W0 clears rc_w0 flags: a write of ones keeps the flags set meanwhile, the host memory needs an RMW. */
+#ifdef _HOST_
+ #define MCUDRV_PERIPH(type, addr) ((type *) Mcudrv::Host::RegAddress(addr))
+ #define MCUDRV_HOST_HOOK(x) x
+ #define MCUDRV_RC_W0(reg, mask) ((reg) &= ~(mask))
+#else
+ #define MCUDRV_PERIPH(type, addr) ((type *) (addr))
+ #define MCUDRV_HOST_HOOK(x)
+ #define MCUDRV_RC_W0(reg, mask) ((reg) = ~(mask))
+#endif
+
 #if defined(STM8S105) || defined(STM8S005) || defined(STM8S103) || defined(STM8S003) || \
     defined(STM8S903) || defined(STM8AF626x) || defined(STM8AF622x)
- #define ADC1 ((ADC1_TypeDef *) ADC1_BaseAddress)
+ #define ADC1 MCUDRV_PERIPH(ADC1_TypeDef, ADC1_BaseAddress)
 #endif /* (STM8S105) ||(STM8S103) || (STM8S005) ||(STM8S003) || (STM8S903) || (STM8AF626x) || (STM8AF622x)*/
 
 #if defined(STM8S208) || defined(STM8S207) || defined (STM8S007) || defined (STM8AF52Ax) || \
     defined (STM8AF62Ax)
-#define ADC2 ((ADC2_TypeDef *) ADC2_BaseAddress)
+#define ADC2 MCUDRV_PERIPH(ADC2_TypeDef, ADC2_BaseAddress)
 #endif /* (STM8S208) ||(STM8S207) || (STM8S007) || (STM8AF52Ax) || (STM8AF62Ax) */
 
-#define AWU ((AWU_TypeDef *) AWU_BaseAddress)
+#define AWU MCUDRV_PERIPH(AWU_TypeDef, AWU_BaseAddress)
 
-#define BEEP ((BEEP_TypeDef *) BEEP_BaseAddress)
+#define BEEP MCUDRV_PERIPH(BEEP_TypeDef, BEEP_BaseAddress)
 
 #if defined (STM8S208) || defined (STM8AF52Ax)
- #define CAN ((CAN_TypeDef *) CAN_BaseAddress)
+ #define CAN MCUDRV_PERIPH(CAN_TypeDef, CAN_BaseAddress)
 #endif /* (STM8S208) || (STM8AF52Ax) */
 
-#define CLK ((CLK_TypeDef *) CLK_BaseAddress)
+#define CLK MCUDRV_PERIPH(CLK_TypeDef, CLK_BaseAddress)
 
-#define EXTI ((EXTI_TypeDef *) EXTI_BaseAddress)
+#define EXTI MCUDRV_PERIPH(EXTI_TypeDef, EXTI_BaseAddress)
 
-#define FLASH ((FLASH_TypeDef *) FLASH_BaseAddress)
+#define FLASH MCUDRV_PERIPH(FLASH_TypeDef, FLASH_BaseAddress)
 
-#define OPT ((OPT_TypeDef *) OPT_BaseAddress)
+#define OPT MCUDRV_PERIPH(OPT_TypeDef, OPT_BaseAddress)
 
-#define GPIOA ((GPIO_TypeDef *) GPIOA_BaseAddress)
+#define GPIOA MCUDRV_PERIPH(GPIO_TypeDef, GPIOA_BaseAddress)
 
-#define GPIOB ((GPIO_TypeDef *) GPIOB_BaseAddress)
+#define GPIOB MCUDRV_PERIPH(GPIO_TypeDef, GPIOB_BaseAddress)
 
-#define GPIOC ((GPIO_TypeDef *) GPIOC_BaseAddress)
+#define GPIOC MCUDRV_PERIPH(GPIO_TypeDef, GPIOC_BaseAddress)
 
-#define GPIOD ((GPIO_TypeDef *) GPIOD_BaseAddress)
+#define GPIOD MCUDRV_PERIPH(GPIO_TypeDef, GPIOD_BaseAddress)
 
-#define GPIOE ((GPIO_TypeDef *) GPIOE_BaseAddress)
+#define GPIOE MCUDRV_PERIPH(GPIO_TypeDef, GPIOE_BaseAddress)
 
-#define GPIOF ((GPIO_TypeDef *) GPIOF_BaseAddress)
+#define GPIOF MCUDRV_PERIPH(GPIO_TypeDef, GPIOF_BaseAddress)
 
 #if defined(STM8S207) || defined (STM8S007) || defined(STM8S208) || defined(STM8S105) || \
     defined(STM8S005) || defined (STM8AF52Ax) || defined (STM8AF62Ax) || defined (STM8AF626x)
- #define GPIOG ((GPIO_TypeDef *) GPIOG_BaseAddress)
+ #define GPIOG MCUDRV_PERIPH(GPIO_TypeDef, GPIOG_BaseAddress)
 #endif /* (STM8S208) ||(STM8S207)  || (STM8S105) || (STM8AF52Ax) || (STM8AF62Ax) || (STM8AF626x) */
 
 #if defined(STM8S207) || defined (STM8S007) || defined(STM8S208) || defined (STM8AF52Ax) || \
     defined (STM8AF62Ax)
- #define GPIOH ((GPIO_TypeDef *) GPIOH_BaseAddress)
- #define GPIOI ((GPIO_TypeDef *) GPIOI_BaseAddress)
+ #define GPIOH MCUDRV_PERIPH(GPIO_TypeDef, GPIOH_BaseAddress)
+ #define GPIOI MCUDRV_PERIPH(GPIO_TypeDef, GPIOI_BaseAddress)
 #endif /* (STM8S208) ||(STM8S207) || (STM8AF62Ax) || (STM8AF52Ax) */
 
-#define RST ((RST_TypeDef *) RST_BaseAddress)
+#define RST MCUDRV_PERIPH(RST_TypeDef, RST_BaseAddress)
 
-#define WWDG ((WWDG_TypeDef *) WWDG_BaseAddress)
-#define IWDG ((IWDG_TypeDef *) IWDG_BaseAddress)
+#define WWDG MCUDRV_PERIPH(WWDG_TypeDef, WWDG_BaseAddress)
+#define IWDG MCUDRV_PERIPH(IWDG_TypeDef, IWDG_BaseAddress)
 
-#define SPI ((SPI_TypeDef *) SPI_BaseAddress)
-#define I2C ((I2C_TypeDef *) I2C_BaseAddress)
+#define SPI MCUDRV_PERIPH(SPI_TypeDef, SPI_BaseAddress)
+#define I2C MCUDRV_PERIPH(I2C_TypeDef, I2C_BaseAddress)
 
 #if defined(STM8S208) ||defined(STM8S207) || defined (STM8S007) || defined(STM8S103) || \
     defined(STM8S003) ||defined(STM8S903) || defined (STM8AF52Ax) || defined (STM8AF62Ax)
- #define UART1 ((UART1_TypeDef *) UART1_BaseAddress)
+ #define UART1 MCUDRV_PERIPH(UART1_TypeDef, UART1_BaseAddress)
 #endif /* (STM8S208) ||(STM8S207)  || (STM8S103) || (STM8S903) || (STM8AF52Ax) || (STM8AF62Ax) */
 
 #if defined (STM8S105) || defined (STM8S005) || defined (STM8AF626x)
- #define UART2 ((UART2_TypeDef *) UART2_BaseAddress)
+ #define UART2 MCUDRV_PERIPH(UART2_TypeDef, UART2_BaseAddress)
 #endif /* STM8S105 || STM8S005 || STM8AF626x */
 
 #if defined(STM8S208) ||defined(STM8S207) || defined (STM8S007) || defined (STM8AF52Ax) || \
     defined (STM8AF62Ax)
- #define UART3 ((UART3_TypeDef *) UART3_BaseAddress)
+ #define UART3 MCUDRV_PERIPH(UART3_TypeDef, UART3_BaseAddress)
 #endif /* (STM8S208) ||(STM8S207) || (STM8AF62Ax) || (STM8AF52Ax) */
 
 #if defined(STM8AF622x)
- #define UART4 ((UART4_TypeDef *) UART4_BaseAddress)
+ #define UART4 MCUDRV_PERIPH(UART4_TypeDef, UART4_BaseAddress)
 #endif /* (STM8AF622x) */
 
-#define TIM1 ((TIM1_TypeDef *) TIM1_BaseAddress)
+#define TIM1 MCUDRV_PERIPH(TIM1_TypeDef, TIM1_BaseAddress)
 
 #if defined(STM8S208) || defined(STM8S207) || defined (STM8S007) || defined(STM8S103) || \
     defined(STM8S003) || defined(STM8S105) || defined(STM8S005) || defined (STM8AF52Ax) || \
     defined (STM8AF62Ax) || defined (STM8AF626x)
- #define TIM2 ((TIM2_TypeDef *) TIM2_BaseAddress)
+ #define TIM2 MCUDRV_PERIPH(TIM2_TypeDef, TIM2_BaseAddress)
 #endif /* (STM8S208) ||(STM8S207)  || (STM8S103) || (STM8S105) || (STM8AF52Ax) || (STM8AF62Ax) || (STM8AF626x)*/
 
 #if defined(STM8S208) || defined(STM8S207) || defined (STM8S007) || defined(STM8S105) || \
     defined(STM8S005) || defined (STM8AF52Ax) || defined (STM8AF62Ax) || defined (STM8AF626x)
- #define TIM3 ((TIM3_TypeDef *) TIM3_BaseAddress)
+ #define TIM3 MCUDRV_PERIPH(TIM3_TypeDef, TIM3_BaseAddress)
 #endif /* (STM8S208) ||(STM8S207)  || (STM8S105) || (STM8AF62Ax) || (STM8AF52Ax) || (STM8AF626x)*/
 
 #if defined(STM8S208) ||defined(STM8S207) || defined (STM8S007) || defined(STM8S103) || \
     defined(STM8S003) || defined(STM8S105) || defined(STM8S005) || defined (STM8AF52Ax) || \
     defined (STM8AF62Ax) || defined (STM8AF626x)
- #define TIM4 ((TIM4_TypeDef *) TIM4_BaseAddress)
+ #define TIM4 MCUDRV_PERIPH(TIM4_TypeDef, TIM4_BaseAddress)
 #endif /* (STM8S208) ||(STM8S207)  || (STM8S103) || (STM8S105) || (STM8AF52Ax) || (STM8AF62Ax) || (STM8AF626x)*/
 
 #if defined (STM8S903) || defined (STM8AF622x)
- #define TIM5 ((TIM5_TypeDef *) TIM5_BaseAddress)
- #define TIM6 ((TIM6_TypeDef *) TIM6_BaseAddress)
+ #define TIM5 MCUDRV_PERIPH(TIM5_TypeDef, TIM5_BaseAddress)
+ #define TIM6 MCUDRV_PERIPH(TIM6_TypeDef, TIM6_BaseAddress)
 #endif /* (STM8S903) || (STM8AF622x) */
 
-#define ITC ((ITC_TypeDef *) ITC_BaseAddress)
+#define ITC MCUDRV_PERIPH(ITC_TypeDef, ITC_BaseAddress)
 
-#define CFG ((CFG_TypeDef *) CFG_BaseAddress)
+#define CFG MCUDRV_PERIPH(CFG_TypeDef, CFG_BaseAddress)
 
-#define DM ((DM_TypeDef *) DM_BaseAddress)
+#define DM MCUDRV_PERIPH(DM_TypeDef, DM_BaseAddress)
 
 
 #ifdef USE_STDPERIPH_DRIVER
@@ -2741,6 +2763,16 @@ CFG_TypeDef;
  #define trap()                {_asm("trap\n");} /* Trap (soft IT) */
  #define wfi()                 {_asm("wfi\n");}  /* Wait For Interrupt */
  #define halt()                {_asm("halt\n");} /* Halt */
+#elif defined(_HOST_)
+ #include "host_regs.h"
+ #define enableInterrupts()    __enable_interrupt()
+ #define disableInterrupts()   __disable_interrupt()
+ #define rim()                 __enable_interrupt()
+ #define sim()                 __disable_interrupt()
+ #define nop()                 __no_operation()
+ #define trap()                __trap()
+ #define wfi()                 __wait_for_interrupt()
+ #define halt()                __halt()
 #else /*_IAR_*/
  #include <intrinsics.h>
  #define enableInterrupts()    __enable_interrupt()   /* enable interrupts */
@@ -2765,7 +2797,7 @@ CFG_TypeDef;
  #define INTERRUPT_HANDLER_TRAP(a) void a(void) trap
 #endif /* _RAISONANCE_ */
 
-#ifdef _IAR_
+#if defined(_IAR_) || defined(_HOST_)
  #define STRINGVECTOR(x) #x
  #define VECTOR_ID(x) STRINGVECTOR( vector = (x) )
  #define INTERRUPT_HANDLER( a, b )  \
@@ -2914,12 +2946,12 @@ CFG_TypeDef;
 
 #endif
 
-#endif /* _IAR_ */
+#endif /* _IAR_ || _HOST_ */
 
 /*============================== Interrupt Handler declaration ========================*/
 #ifdef _COSMIC_
  #define INTERRUPT @far @interrupt
-#elif defined(_IAR_)
+#elif defined(_IAR_) || defined(_HOST_)
  #define INTERRUPT __interrupt
 #endif /* _COSMIC_ */
 
@@ -22,6 +22,7 @@
 
 #pragma once
 #include "stm8s.h"
+#include "clock.h"
 //#include "static_assert.h"
 
 namespace Mcudrv
@@ -36,6 +37,28 @@ namespace Mcudrv
 			Ch4,
             All_Ch
 		};
+		// Input capture edge, CCxP of a channel in input mode
+		enum CaptureEdge
+		{
+			RisingEdge,
+			FallingEdge
+		};
+		// SysClock::ClockManager listener. The prescaler saturates at its limits (1 and 65536 for TIM1,
+		// Div_1 and Div_32768 for TIM2/3), the timer then runs at a different rate. Divider is the counter
+		// clock divider set at F_CPU (the Init() divider for TIM1, 1 << Div for TIM2/3), it's checked to
+		// scale exactly up to F_CPU << SYSCLOCK_MAX_SHIFT, so ScalePrescaler() can't fail.
+		template<typename Timer, uint16_t Divider>
+		struct ClockSync
+		{
+			static_assert(Timer::template DividerScales<Divider, SYSCLOCK_MAX_SHIFT>::value,
+						  "Timer prescaler saturates at the highest clock");
+			static void BeforeClockChange()
+			{ }
+			static void OnClockChange(const int8_t scale)
+			{
+				Timer::ScalePrescaler(scale);
+			}
+		};
 	}
 	namespace T1
 	{
@@ -111,9 +134,26 @@ namespace Mcudrv
 		{
 //			Default = 0,
 			MSM = TIM1_SMCR_MSM,
-			//TODO: implement
+//			---=== Slave mode selection (SMS) ===---
+			EncoderMode1 = 0x01,		// Counter counts up/down on TI2FP2 edge depending on TI1FP1 level
+			EncoderMode2 = 0x02,		// Counter counts up/down on TI1FP1 edge depending on TI2FP2 level
+			EncoderMode3 = 0x03,		// Counter counts up/down on both TI1FP1 and TI2FP2 edges depending on the level of the other input
+			ResetMode = 0x04,			// Rising edge of the trigger input (TRGI) reinitializes the counter
+			GatedMode = 0x05,			// The counter clock is enabled when the trigger input (TRGI) is high
+			TriggerMode = 0x06,			// The counter starts at a rising edge of the trigger TRGI
+			ExtClockMode1 = 0x07,		// Rising edges of the selected trigger (TRGI) clock the counter
+//			---=== Trigger selection (TS) ===---
+			TrigTI1F_ED = 0x04 << 4u,	// TI1 edge detector
+			TrigTI1FP1 = 0x05 << 4u,	// Filtered timer input 1
+			TrigTI2FP2 = 0x06 << 4u,	// Filtered timer input 2
+			TrigETRF = 0x07 << 4u		// External trigger input
 		};
 
+		inline SlaveModeCtrl operator|(SlaveModeCtrl a, SlaveModeCtrl b)
+		{
+			return static_cast<SlaveModeCtrl>(static_cast<int>(a) | static_cast<int>(b));
+		}
+
 		enum Ints
 		{
 			IRQ_Update = TIM1_IER_UIE,
@@ -213,6 +253,12 @@ namespace Mcudrv
 				TIM1->BKR |= TIM1_BKR_MOE;
 			}
 
+			FORCEINLINE
+			static void SetSlaveMode(const SlaveModeCtrl mode)
+			{
+				TIM1->SMCR = mode;
+			}
+
 			FORCEINLINE
 			static void Enable()
 			{
@@ -241,7 +287,7 @@ namespace Mcudrv
 			FORCEINLINE
 			static void ClearIntFlag(const Ints flag)
 			{
-				TIM1->SR1 &= ~flag;
+				MCUDRV_RC_W0(TIM1->SR1, flag);		// RMW could clear a flag set meanwhile
 			}
 			FORCEINLINE
 			static void TriggerEvent(const Events ev)
@@ -258,6 +304,13 @@ namespace Mcudrv
 	//			Enable();
 			}
 
+#ifdef _HOST_
+			static uint16_t ReadCounter()
+			{
+				const uint8_t msb = TIM1->CNTRH;
+				return (msb << 8) | TIM1->CNTRL;
+			}
+#else
 			#pragma diag_suppress=Pe940
 			static uint16_t ReadCounter()
 			{
@@ -267,6 +320,7 @@ namespace Mcudrv
 						"LD XL, A\n");
 			}
 			#pragma diag_default=Pe940
+#endif
 			
 			FORCEINLINE
 			static void WriteAutoReload(const uint16_t c)
@@ -274,6 +328,24 @@ namespace Mcudrv
 				TIM1->ARRH = c >> 8;
 				TIM1->ARRL = (uint8_t)c;
 			}
+			// Counter clock divider which stays exact when multiplied by 2^shift
+			template<uint16_t divider, uint8_t shift>
+			struct DividerScales
+			{
+				static const bool value = divider && ((uint32_t)divider << shift) <= 0x10000UL;
+			};
+			// Keeps the counter clock on fMASTER change by 2^scale, applied at the next update event
+			// Multiplies the prescaler by 2^scale, returns false if it's saturated or rounded
+			static bool ScalePrescaler(const int8_t scale)
+			{
+				const uint32_t div = ((uint16_t)(TIM1->PSCRH << 8) | TIM1->PSCRL) + 1UL;
+				uint32_t scaled = scale > 0 ? div << scale : div >> -scale;
+				const bool exact = scaled && scaled <= 0x10000UL && (scale >= 0 || scaled << -scale == div);
+				scaled = scaled > 0x10000UL ? 0x10000UL : scaled ? scaled : 1;
+				TIM1->PSCRH = (uint8_t)((scaled - 1) >> 8);
+				TIM1->PSCRL = (uint8_t)(scaled - 1);
+				return exact;
+			}
 
 			FORCEINLINE
 			template <Channel Ch, ChannelType type, ChannelCfgIn cfg>
@@ -334,6 +406,16 @@ namespace Mcudrv
                 if ((Ch & Ch2) == Ch2) TIM1->CCER1 |= TIM1_CCER1_CC2NE | ((level << 3) << 4);
                 if ((Ch & Ch1) == Ch1) TIM1->CCER1 |= TIM1_CCER1_CC1NE | (level << 3);
 			}
+
+			// Input capture on TIx (InputMap0) or on the input of the paired channel (InputMap1)
+			FORCEINLINE
+			template <Channel Ch, ChannelType type, ChannelCfgIn cfg, CaptureEdge edge>
+			static void EnableCapture()
+			{
+				ChannelDisable<Ch>();			// CCxS is writable only when the channel is off
+				SetChannelCfg<Ch, type, cfg>();
+				ChannelEnable<Ch, ActiveLevel(edge)>();
+			}
  		
 			FORCEINLINE
 			template<Channel Ch>
@@ -354,7 +436,9 @@ namespace Mcudrv
 			template<Channel Ch>
 			static uint16_t ReadCompareWord()
 			{
-				return *reinterpret_cast<volatile uint16_t*>(&TIM1->CCR1H + Ch * 2);
+				volatile uint8_t* const ccr = &TIM1->CCR1H + Ch * 2;
+				const uint8_t msb = ccr[0];
+				return (msb << 8) | ccr[1];
 			}
 
 			FORCEINLINE
@@ -364,6 +448,16 @@ namespace Mcudrv
 				return *reinterpret_cast<volatile uint8_t*>(&TIM1->CCR1L + Ch * 2);
 			}
 
+			// MSB first: the capture is inhibited until the LSB is read, which clears CCxIF
+			FORCEINLINE
+			template<Channel Ch>
+			static uint16_t ReadCapture()
+			{
+				const uint16_t value = ReadCompareWord<Ch>();
+				MCUDRV_HOST_HOOK(Host::CaptureRead(TIM1_BaseAddress, Ch));
+				return value;
+			}
+
 			FORCEINLINE
 			template<Channel Ch>
 			static volatile uint16_t& GetCompareWord()
@@ -500,7 +594,7 @@ namespace Mcudrv
 				FORCEINLINE
 				static TIM_TypeDef* Regs()
 				{
-					return reinterpret_cast<TIM_TypeDef*>(BaseAddr);
+					return MCUDRV_PERIPH(TIM_TypeDef, BaseAddr);
 				}
 			public:
 				static void Init(const Div divider, const Cfg config)
@@ -542,7 +636,7 @@ namespace Mcudrv
 				FORCEINLINE
 				static void ClearIntFlag(const Ints flag)
 				{
-					Regs()->SR1 &= ~flag;
+					MCUDRV_RC_W0(Regs()->SR1, flag);	// RMW could clear a flag set meanwhile
 				}
 				static void WriteCounter(const uint16_t c)	//Need to stop Timer
 				{
@@ -566,6 +660,22 @@ namespace Mcudrv
 				{
 					Regs()->PSCR = div;
 				}
+				// Counter clock divider which is a prescaler setting and stays one when multiplied by 2^shift
+				template<uint16_t divider, uint8_t shift>
+				struct DividerScales
+				{
+					static const bool value = divider && !(divider & (divider - 1)) &&
+											  ((uint32_t)divider << shift) <= (1UL << Div_32768);
+				};
+				// Keeps the counter clock on fMASTER change by 2^scale, applied at the next update event
+				// Multiplies the prescaler by 2^scale, returns false if it's saturated
+				static bool ScalePrescaler(const int8_t scale)
+				{
+					const int8_t div = (int8_t)(Regs()->PSCR + scale);
+					const int8_t maxDiv = (int8_t)Div_32768;
+					Regs()->PSCR = (uint8_t)(div < 0 ? 0 : div > maxDiv ? maxDiv : div);
+					return div >= 0 && div <= maxDiv;
+				}
 
 				FORCEINLINE
 				template <Channel Ch, ChannelType type, ChannelCfgIn cfg>
@@ -625,6 +735,16 @@ namespace Mcudrv
 					if (Ch == Ch1) Regs()->CCER1 &= ~0x0F;
 				}
 
+				// Input capture on TIx (InputMap0) or on the input of the paired channel (InputMap1)
+				FORCEINLINE
+				template <Channel Ch, ChannelType type, ChannelCfgIn cfg, CaptureEdge edge>
+				static void EnableCapture()
+				{
+					ChannelDisable<Ch>();			// CCxS is writable only when the channel is off
+					SetChannelCfg<Ch, type, cfg>();
+					ChannelEnable<Ch, ActiveLevel(edge)>();
+				}
+
 				FORCEINLINE
 				template<Channel Ch>
 				static void WriteCompareWord(const uint16_t c)
@@ -647,7 +767,9 @@ namespace Mcudrv
 				static uint16_t ReadCompareWord()
 				{
 					static_assert(!(Ch == Ch3 && BaseAddr == TIM3_BaseAddress), "Timer 3 have no Channel 3");
-					return *reinterpret_cast<volatile uint16_t*>(&Regs()->CCR1H + Ch * 2);
+					volatile uint8_t* const ccr = &Regs()->CCR1H + Ch * 2;
+					const uint8_t msb = ccr[0];
+					return (msb << 8) | ccr[1];
 				}
 
 				FORCEINLINE
@@ -658,6 +780,16 @@ namespace Mcudrv
 					return *reinterpret_cast<volatile uint8_t*>(&Regs()->CCR1L + Ch * 2);
 				}
 
+				// MSB first: the capture is inhibited until the LSB is read, which clears CCxIF
+				FORCEINLINE
+				template<Channel Ch>
+				static uint16_t ReadCapture()
+				{
+					const uint16_t value = ReadCompareWord<Ch>();
+					MCUDRV_HOST_HOOK(Host::CaptureRead(BaseAddr, Ch));
+					return value;
+				}
+
 				FORCEINLINE
 				template<Channel Ch>
 				static volatile uint16_t& GetCompareWord()
@@ -22,9 +22,12 @@
 
 #pragma once
 #include "circularBuffer.h"
+#include "clock.h"
+#include "format.h"
 #include "gpio.h"
 #include "stm8s.h"
 #include "string_utils.h"
+#include "timers.h"
 
 namespace Mcudrv {
 
@@ -123,6 +126,31 @@ struct Base<UART2_BaseAddress>
     typedef Pd5 TxPin;
     typedef Pd6 RxPin;
 };
+// Smallest timer prescaler (power of 2) keeping Ticks below the counter range with some margin
+template<uint32_t Ticks, uint8_t Presc = 0, bool Fits = (Ticks >> Presc) < 0xF000UL>
+struct AutoBaudPrescaler
+{
+    enum
+    {
+        value = AutoBaudPrescaler<Ticks, Presc + 1>::value
+    };
+};
+template<uint32_t Ticks, uint8_t Presc>
+struct AutoBaudPrescaler<Ticks, Presc, true>
+{
+    enum
+    {
+        value = Presc
+    };
+};
+// Divider found by Uart::AutoBaud, 0 - none
+template<typename T = void>
+struct AutoBaudState
+{
+    static uint16_t divider;
+};
+template<typename T>
+uint16_t AutoBaudState<T>::divider;
 } // Internal
 
 // class based on polling routines
@@ -141,8 +169,9 @@ public:
     FORCEINLINE
     static BaseType* Regs()
     {
-        return reinterpret_cast<BaseType*>(BaseAddr);
+        return MCUDRV_PERIPH(BaseType, BaseAddr);
     }
+    // The divider found by AutoBaud() is kept, baud applies without it (or after ClearAutoBaud())
     FORCEINLINE
     template<Cfg config, BaudRate baud = 9600UL>
     static void Init()
@@ -154,8 +183,8 @@ public:
         static_assert(Div <= __UINT16_T_MAX__ && Div > 0x0F, "UART divider not in range 16...65535");
         static_assert(!(BaseAddr == UART2_BaseAddress && (static_cast<uint32_t>(config) >> 24) & UART1_CR5_HDSEL),
                       "Single wire Halfduplex mode not available for UART2");
-        Regs()->BRR2 = ((Div >> 8U) & 0xF0) | (Div & 0x0F);
-        Regs()->BRR1 = (Div >> 4U) & 0xFF;
+        const uint16_t detected = Internal::AutoBaudState<>::divider;
+        SetBaudDivider(detected ? detected : uint16_t(Div));
         Regs()->CR1 = static_cast<uint32_t>(config) & 0xFF;
         //	Regs()->CR3 = (static_cast<uint32_t>(config) >> 16) & 0xFF; //Need for synchronuos communication and LIN
         Regs()->CR5 = (static_cast<uint32_t>(config) >> 24) & 0xFF;
@@ -168,6 +197,95 @@ public:
             RxPin::SetConfig<GpioBase::In_Pullup>();
         }
     }
+    // RX line level, TX pin carries RX data in single wire mode
+    FORCEINLINE
+    static bool RxLevel()
+    {
+        return Regs()->CR5 & UART1_CR5_HDSEL ? TxPin::IsSet() : RxPin::IsSet();
+    }
+    // Divider = F_CPU / baudrate, 16...65535
+    FORCEINLINE
+    static void SetBaudDivider(const uint16_t div)
+    {
+        // BRR2 has to be written first, BRR1 write updates the divider
+        Regs()->BRR2 = ((div >> 8U) & 0xF0) | (div & 0x0F);
+        Regs()->BRR1 = (div >> 4U) & 0xFF;
+    }
+    // Sets the baudrate from the known SyncByte sent by the host (e.g. 0x55, BOOTSTART_KEY or Wake FEND).
+    // The RX pin is polled and its edges are timestamped by free running Timer (T2::Timer2 or T2::Timer3,
+    // reconfigured here). Bit time is taken from the span between the start bit and the last rising edge,
+    // then every edge is checked to be within half a bit of its expected position.
+    // Waits up to idlePolls loop passes for the start bit. Returns false on timeout or if the measured byte
+    // doesn't match SyncByte, the divider is left unchanged then. minBaud selects the timer prescaler.
+    // The divider found is kept by the following Init() calls (ClearAutoBaud() drops it).
+    template<uint8_t SyncByte, typename Timer = T2::Timer2, BaudRate minBaud = 1200UL>
+    static bool AutoBaud(uint16_t idlePolls)
+    {
+        enum
+        {
+            Frame = (SyncByte << 1) | 0x200, // start bit, data LSB first, stop bit
+            Prescaler = Internal::AutoBaudPrescaler<F_CPU * 10 / minBaud>::value,
+            MaxTicks = 0xF000
+        };
+        Timer::Init(T2::Div(Prescaler), T2::CEN);
+        Timer::WriteAutoReload(0xFFFF);
+        while(RxLevel()) {
+            if(!idlePolls--) {
+                return false;
+            }
+        }
+        const uint16_t start = Timer::ReadCounter();
+        const uint8_t cr2 = Regs()->CR2;
+        Regs()->CR2 = cr2 & ~UART1_CR2_REN; // keep the receiver off the wrong rate byte
+        uint16_t edges[9];
+        uint8_t lastRise = 0;
+        bool level = false;
+        for(uint8_t i = 1; i < 10; ++i) {
+            const bool bit = Frame & (1U << i);
+            edges[i - 1] = 0;
+            if(bit == level) {
+                continue;
+            }
+            level = bit;
+            uint16_t elapsed;
+            do {
+                elapsed = Timer::ReadCounter() - start;
+                if(elapsed > MaxTicks) {
+                    Regs()->CR2 = cr2;
+                    return false;
+                }
+            } while(RxLevel() != level);
+            edges[i - 1] = elapsed;
+            if(bit) {
+                lastRise = i;
+            }
+        }
+        Regs()->CR2 = cr2;
+        const uint16_t span = edges[lastRise - 1];
+        for(uint8_t i = 1; i < lastRise; ++i) {
+            if(edges[i - 1]) {
+                int32_t dev = int32_t(edges[i - 1]) * lastRise - int32_t(i) * span;
+                if(dev < 0) {
+                    dev = -dev;
+                }
+                if(dev > span / 2) {
+                    return false;
+                }
+            }
+        }
+        const uint32_t div = ((uint32_t(span) << Prescaler) + lastRise / 2) / lastRise;
+        if(div <= 0x0F || div > 0xFFFF) {
+            return false;
+        }
+        Internal::AutoBaudState<>::divider = div;
+        SetBaudDivider(div);
+        return true;
+    }
+    // Init() uses its baud argument again
+    static void ClearAutoBaud()
+    {
+        Internal::AutoBaudState<>::divider = 0;
+    }
     FORCEINLINE
     static void SetNodeAddress(const uint8_t addr) // Incompatible With LIN mode
     {
@@ -189,13 +307,26 @@ public:
     static void ClearEvent(const Events event)
     {
         if(event & EvTxComplete) {
-            Regs()->SR = ~event;
+            MCUDRV_RC_W0(Regs()->SR, event);
         }
         if(event & EvRxne) {
-            uint8_t dummy = Uart::Regs()->DR;
-            (void)dummy;
+            (void)ReadData();
         }
     }
+    // Data register access, the host build models the side effects
+    FORCEINLINE
+    static void WriteData(const uint8_t c)
+    {
+        Regs()->DR = c;
+        MCUDRV_HOST_HOOK(Host::UartWritten(BaseAddr));
+    }
+    FORCEINLINE
+    static uint8_t ReadData()
+    {
+        const uint8_t c = Regs()->DR;
+        MCUDRV_HOST_HOOK(Host::UartRead(BaseAddr));
+        return c;
+    }
 
     FORCEINLINE
     static void EnableInterrupt(const Irqs mask)
@@ -212,7 +343,24 @@ public:
     {
         while(!IsEvent(EvTxEmpty))
             ;
-        Regs()->DR = ch;
+        WriteData(ch);
+    }
+    // Non-blocking variants for cooperative tasks, false if the UART is busy
+    static bool TryPutch(const uint8_t ch)
+    {
+        if(!IsEvent(EvTxEmpty)) {
+            return false;
+        }
+        WriteData(ch);
+        return true;
+    }
+    static bool TryGetch(uint8_t& ch)
+    {
+        if(!IsEvent(EvRxne)) {
+            return false;
+        }
+        ch = ReadData();
+        return true;
     }
     static void Puts(const uint8_t* s)
     {
@@ -236,22 +384,142 @@ public:
     {
         while(!IsEvent(EvRxne))
             ;
-        uint8_t ch = Regs()->DR;
+        uint8_t ch = ReadData();
 #ifdef UARTECHO
-        Regs()->DR = ch;
+        WriteData(ch);
 #endif
         return ch;
     }
 };
 // class based on interrupts and circular buffer
-template<uint16_t TxBufSize = 16, uint16_t RxBufSize = TxBufSize, typename DEpin = Nullpin>
+// TxDescCount > 0 enables zero-copy transmission: QueueBuf() queues a reference to the caller's buffer
+// (flash or RAM that stays valid until the completion callback), which is sent by TxISR directly.
+// Copied and referenced data are transmitted in the order they were queued.
+// RxMsgCount > 0 enables IDLE line framing: a message ends when the line goes idle after the last byte,
+// lengths of up to RxMsgCount pending messages are kept and the callback set by SetRxCallback is called
+// from RxISR for each one. Messages are taken with GetMessage().
+template<uint16_t TxBufSize = 16,
+         uint16_t RxBufSize = TxBufSize,
+         typename DEpin = Nullpin,
+         uint8_t TxDescCount = 0,
+         uint8_t RxMsgCount = 0>
 class UartIrq : public Uart
 {
+public:
+    typedef void (*TxCallback)(const uint8_t* buf);
+    typedef void (*RxCallback)(uint16_t len);
+    struct RxStats
+    {
+        uint16_t parityErr;
+        uint16_t frameErr;
+        uint16_t noiseErr;
+        uint16_t overrunErr;
+        uint16_t overflow; // bytes dropped because rxbuf_ was full
+    };
 protected:
     typedef Uart Base;
-    typedef UartIrq<TxBufSize, RxBufSize, DEpin> Self;
+    typedef UartIrq<TxBufSize, RxBufSize, DEpin, TxDescCount, RxMsgCount> Self;
+    struct TxDesc
+    {
+        const uint8_t* ptr;
+        uint16_t len;
+        TxCallback cb;
+        uint16_t mark; // txbuf_ bytes to be sent before this descriptor
+    };
+    enum
+    {
+        DescMode = TxDescCount != 0,
+        MsgMode = RxMsgCount != 0
+    };
+    static_assert((TxDescCount & (TxDescCount - 1)) == 0, "TxDescCount must be 0 or a power of 2");
+    static_assert((RxMsgCount & (RxMsgCount - 1)) == 0, "RxMsgCount must be 0 or a power of 2");
     static CircularBuffer<TxBufSize> txbuf_;
     static CircularBuffer<RxBufSize> rxbuf_;
+    static CircularBuffer<DescMode ? TxDescCount : 1, TxDesc> txdesc_;
+    static TxDesc txcur_;
+    static uint16_t txcurPos_;
+    static uint16_t txWritten_; // bytes put to txbuf_, producer side
+    static uint16_t txSent_;    // bytes taken from txbuf_, ISR side
+    static CircularBuffer<MsgMode ? RxMsgCount : 1, uint16_t> rxmsg_;
+    static uint16_t rxMsgLen_; // bytes of the message being received
+    static RxCallback rxCallback_;
+    static RxStats rxStats_;
+
+    FORCEINLINE
+    static void CountWritten(uint16_t, stdx::Int2Type<false>)
+    { }
+    FORCEINLINE
+    static void CountWritten(uint16_t n, stdx::Int2Type<true>)
+    {
+        txWritten_ += n;
+    }
+
+    // Returns false when there is nothing to send
+    FORCEINLINE
+    static bool TxNext(uint8_t& c, stdx::Int2Type<false>)
+    {
+        return txbuf_.Read(c);
+    }
+    FORCEINLINE
+    static bool TxNext(uint8_t& c, stdx::Int2Type<true>)
+    {
+        for(;;) {
+            if(txcurPos_ != txcur_.len) {
+                c = txcur_.ptr[txcurPos_++];
+                if(txcurPos_ == txcur_.len && txcur_.cb) {
+                    txcur_.cb(txcur_.ptr);
+                }
+                return true;
+            }
+            const TxDesc* desc;
+            if(txdesc_.GetReadSpan(desc) && desc->mark == txSent_) {
+                txcur_ = *desc;
+                txcurPos_ = 0;
+                txdesc_.ConsumeRead(1);
+                if(!txcur_.len && txcur_.cb) {
+                    txcur_.cb(txcur_.ptr);
+                }
+                continue;
+            }
+            if(txbuf_.Read(c)) {
+                ++txSent_;
+                return true;
+            }
+            return false;
+        }
+    }
+
+    FORCEINLINE
+    static void RxByteStored(stdx::Int2Type<false>)
+    { }
+    FORCEINLINE
+    static void RxByteStored(stdx::Int2Type<true>)
+    {
+        ++rxMsgLen_;
+    }
+    FORCEINLINE
+    static void RxIdle(stdx::Int2Type<false>)
+    { }
+    FORCEINLINE
+    static void RxIdle(stdx::Int2Type<true>)
+    {
+        // If there is no room for the boundary, the message is merged with the next one
+        if(rxMsgLen_ && rxmsg_.Write(rxMsgLen_)) {
+            if(rxCallback_) {
+                rxCallback_(rxMsgLen_);
+            }
+            rxMsgLen_ = 0;
+        }
+    }
+    FORCEINLINE
+    static void RxFlush(stdx::Int2Type<false>)
+    { }
+    FORCEINLINE
+    static void RxFlush(stdx::Int2Type<true>)
+    {
+        rxmsg_.Clear();
+        rxMsgLen_ = 0;
+    }
 public:
     enum
     {
@@ -265,24 +533,21 @@ public:
     {
         Base::Init<config, baud>();
         DEpin::template SetConfig<GpioBase::Out_PushPull_fast>();
-        EnableInterrupt(Irqs(IrqRxne | IrqTxComplete));
+        EnableInterrupt(Irqs(IrqRxne | IrqTxComplete | (MsgMode ? IrqIdle : 0)));
     }
 
     NOINLINE
     static bool Putch(const uint8_t c)
     {
         bool st = txbuf_.Write(c);
+        CountWritten(st, stdx::Int2Type<DescMode>());
         EnableInterrupt(IrqTxEmpty);
         return st;
     }
     NOINLINE
     static uint16_t Puts(const uint8_t* s)
     {
-        const uint8_t* begin = s;
-        while(*s && txbuf_.Write(*s++))
-            ;
-        EnableInterrupt(IrqTxEmpty);
-        return s - begin;
+        return Putbuf(s, strlen((const char*)s));
     }
     static uint16_t Puts(const char* s)
     {
@@ -290,20 +555,52 @@ public:
     }
     NOINLINE
     template<typename T>
-    static uint16_t Puts(T value, uint8_t base = 10)
+    static uint16_t Puts(T value)
+    {
+        uint8_t buf[16];
+        io::xtoa(value, buf);
+        return Puts((const uint8_t*)buf);
+    }
+    NOINLINE
+    template<typename T>
+    static uint16_t Puts(T value, uint8_t base)
     {
         uint8_t buf[16];
-        return Puts(io::xtoa(value, buf, base));
+        io::xtoa(value, buf, base);
+        return Puts((const uint8_t*)buf);
+    }
+    // Formatted output, see format.h
+    template<typename... Args>
+    static void Print(const Args&... args)
+    {
+        io::Print<Self>(args...);
+    }
+    template<uint8_t Placeholders, typename... Args>
+    static void PrintF(io::Format<Placeholders> fmt, const Args&... args)
+    {
+        io::PrintF<Self>(fmt, args...);
     }
 
     NOINLINE
     static uint16_t Putbuf(const uint8_t* buf, uint16_t size)
     {
-        uint16_t target_size = size;
-        while(size-- && txbuf_.Write(*buf++))
-            ;
+        uint16_t written = txbuf_.Write(buf, size);
+        CountWritten(written, stdx::Int2Type<DescMode>());
         EnableInterrupt(IrqTxEmpty);
-        return target_size - size;
+        return written;
+    }
+
+    // Zero-copy transmission, available when TxDescCount > 0. The buffer must stay valid
+    // until the callback is called from TxISR (after the last byte is loaded to the transmitter).
+    static bool QueueBuf(const uint8_t* buf, uint16_t size, TxCallback cb = 0)
+    {
+        static_assert(DescMode, "TxDescCount must be non-zero to use QueueBuf");
+        TxDesc desc = { buf, size, cb, txWritten_ };
+        if(!txdesc_.Write(desc)) {
+            return false;
+        }
+        EnableInterrupt(IrqTxEmpty);
+        return true;
     }
 
     FORCEINLINE
@@ -326,10 +623,56 @@ public:
         return rxbuf_.Read(c);
     }
 
+    // Drops the received data, RxISR is held off: Clear() resets its index too
     FORCEINLINE
     static void Flush()
     {
+        __istate_t state = __get_interrupt_state();
+        __disable_interrupt();
         rxbuf_.Clear();
+        RxFlush(stdx::Int2Type<MsgMode>());
+        __set_interrupt_state(state);
+    }
+
+    // IDLE line framing, available when RxMsgCount > 0
+    static void SetRxCallback(RxCallback cb)
+    {
+        rxCallback_ = cb;
+    }
+    // Length of the oldest complete message, 0 if there is none
+    static uint16_t GetMessageLength()
+    {
+        static_assert(MsgMode, "RxMsgCount must be non-zero to use message framing");
+        return rxmsg_.IsEmpty() ? 0 : rxmsg_.First();
+    }
+    // Copies the oldest complete message to buf, the part exceeding maxLen is discarded
+    static uint16_t GetMessage(uint8_t* buf, uint16_t maxLen)
+    {
+        static_assert(MsgMode, "RxMsgCount must be non-zero to use message framing");
+        uint16_t len;
+        if(!rxmsg_.Read(len)) {
+            return 0;
+        }
+        uint16_t copied = rxbuf_.Read(buf, len < maxLen ? len : maxLen);
+        for(uint16_t rest = len - copied; rest;) {
+            const uint8_t* ptr;
+            uint16_t span = rxbuf_.GetReadSpan(ptr);
+            if(span > rest) {
+                span = rest;
+            }
+            rxbuf_.ConsumeRead(span);
+            rest -= span;
+        }
+        return copied;
+    }
+
+    static const RxStats& GetRxStats()
+    {
+        return rxStats_;
+    }
+    static void ClearRxStats()
+    {
+        rxStats_ = RxStats();
     }
 
 #if defined(STM8S103) || defined(STM8S003)
@@ -346,8 +689,8 @@ public:
         else // if (IsEvent(TxEmpty))
         {
             uint8_t c;
-            if(txbuf_.Read(c))
-                Regs()->DR = c;
+            if(TxNext(c, stdx::Int2Type<DescMode>()))
+                WriteData(c);
             else
                 DisableInterrupt(IrqTxEmpty);
         }
@@ -361,22 +704,97 @@ public:
 #endif
       __interrupt static void RxISR()
     {
-        //			bool error = IsEvent(Events(EvParityErr | EvFrameErr | EvNoiseErr | EvOverrunErr));
-        ////чтение флагов ошибок
-        uint8_t c = Regs()->DR;
-        //			error |= !					//buffer is full
-        rxbuf_.Write(c);
-//			if(error) return;
+        // SR read followed by DR read clears error and IDLE flags
+        const uint8_t sr = Regs()->SR;
+        if(sr & EvRxne) {
+            uint8_t c = ReadData();
+            if(sr & EvParityErr) {
+                ++rxStats_.parityErr;
+            }
+            if(sr & EvFrameErr) {
+                ++rxStats_.frameErr;
+            }
+            if(sr & EvNoiseErr) {
+                ++rxStats_.noiseErr;
+            }
+            if(sr & EvOverrunErr) {
+                ++rxStats_.overrunErr;
+            }
+            if(rxbuf_.Write(c)) {
+                RxByteStored(stdx::Int2Type<MsgMode>());
+            }
+            else {
+                ++rxStats_.overflow;
+            }
 #ifdef UARTECHO
-        Regs()->DR = c; // echo
+            WriteData(c); // echo
 #endif
+        }
+        else if(sr & EvOverrunErr) {
+            (void)ReadData();
+            ++rxStats_.overrunErr;
+        }
+        if(sr & EvIdle) {
+            if(!(sr & (EvRxne | EvOverrunErr))) {
+                (void)ReadData();
+            }
+            RxIdle(stdx::Int2Type<MsgMode>());
+        }
     }
 };
 
-template<uint16_t TxBufSize, uint16_t RxBufSize, typename DEpin>
-CircularBuffer<TxBufSize> UartIrq<TxBufSize, RxBufSize, DEpin>::txbuf_;
-template<uint16_t TxBufSize, uint16_t RxBufSize, typename DEpin>
-CircularBuffer<RxBufSize> UartIrq<TxBufSize, RxBufSize, DEpin>::rxbuf_;
+template<uint16_t TxBufSize, uint16_t RxBufSize, typename DEpin, uint8_t TxDescCount, uint8_t RxMsgCount>
+CircularBuffer<TxBufSize> UartIrq<TxBufSize, RxBufSize, DEpin, TxDescCount, RxMsgCount>::txbuf_;
+template<uint16_t TxBufSize, uint16_t RxBufSize, typename DEpin, uint8_t TxDescCount, uint8_t RxMsgCount>
+CircularBuffer<RxBufSize> UartIrq<TxBufSize, RxBufSize, DEpin, TxDescCount, RxMsgCount>::rxbuf_;
+template<uint16_t TxBufSize, uint16_t RxBufSize, typename DEpin, uint8_t TxDescCount, uint8_t RxMsgCount>
+CircularBuffer<UartIrq<TxBufSize, RxBufSize, DEpin, TxDescCount, RxMsgCount>::DescMode ? TxDescCount : 1,
+               typename UartIrq<TxBufSize, RxBufSize, DEpin, TxDescCount, RxMsgCount>::TxDesc>
+  UartIrq<TxBufSize, RxBufSize, DEpin, TxDescCount, RxMsgCount>::txdesc_;
+template<uint16_t TxBufSize, uint16_t RxBufSize, typename DEpin, uint8_t TxDescCount, uint8_t RxMsgCount>
+typename UartIrq<TxBufSize, RxBufSize, DEpin, TxDescCount, RxMsgCount>::TxDesc
+  UartIrq<TxBufSize, RxBufSize, DEpin, TxDescCount, RxMsgCount>::txcur_;
+template<uint16_t TxBufSize, uint16_t RxBufSize, typename DEpin, uint8_t TxDescCount, uint8_t RxMsgCount>
+uint16_t UartIrq<TxBufSize, RxBufSize, DEpin, TxDescCount, RxMsgCount>::txcurPos_;
+template<uint16_t TxBufSize, uint16_t RxBufSize, typename DEpin, uint8_t TxDescCount, uint8_t RxMsgCount>
+uint16_t UartIrq<TxBufSize, RxBufSize, DEpin, TxDescCount, RxMsgCount>::txWritten_;
+template<uint16_t TxBufSize, uint16_t RxBufSize, typename DEpin, uint8_t TxDescCount, uint8_t RxMsgCount>
+uint16_t UartIrq<TxBufSize, RxBufSize, DEpin, TxDescCount, RxMsgCount>::txSent_;
+template<uint16_t TxBufSize, uint16_t RxBufSize, typename DEpin, uint8_t TxDescCount, uint8_t RxMsgCount>
+CircularBuffer<UartIrq<TxBufSize, RxBufSize, DEpin, TxDescCount, RxMsgCount>::MsgMode ? RxMsgCount : 1, uint16_t>
+  UartIrq<TxBufSize, RxBufSize, DEpin, TxDescCount, RxMsgCount>::rxmsg_;
+template<uint16_t TxBufSize, uint16_t RxBufSize, typename DEpin, uint8_t TxDescCount, uint8_t RxMsgCount>
+uint16_t UartIrq<TxBufSize, RxBufSize, DEpin, TxDescCount, RxMsgCount>::rxMsgLen_;
+template<uint16_t TxBufSize, uint16_t RxBufSize, typename DEpin, uint8_t TxDescCount, uint8_t RxMsgCount>
+typename UartIrq<TxBufSize, RxBufSize, DEpin, TxDescCount, RxMsgCount>::RxCallback
+  UartIrq<TxBufSize, RxBufSize, DEpin, TxDescCount, RxMsgCount>::rxCallback_;
+template<uint16_t TxBufSize, uint16_t RxBufSize, typename DEpin, uint8_t TxDescCount, uint8_t RxMsgCount>
+typename UartIrq<TxBufSize, RxBufSize, DEpin, TxDescCount, RxMsgCount>::RxStats
+  UartIrq<TxBufSize, RxBufSize, DEpin, TxDescCount, RxMsgCount>::rxStats_;
+
+// SysClock::ClockManager listener, the baudrate is kept on clock change.
+// Transmission is finished before the switch. There is no receiver busy flag, so the receiver is stopped
+// for the switch: a frame being received is dropped rather than sampled at the wrong rate.
+template<typename Uart, BaudRate baud>
+struct ClockSync
+{
+    static void BeforeClockChange()
+    {
+        while(!Uart::IsEvent(EvTxComplete))
+            ;
+        rxEnable_ = Uart::Regs()->CR2 & UART1_CR2_REN;
+        Uart::Regs()->CR2 &= ~UART1_CR2_REN;
+    }
+    static void OnClockChange(int8_t)
+    {
+        Uart::SetBaudDivider(SysClock::GetFreq() / baud);
+        Uart::Regs()->CR2 |= rxEnable_;
+    }
+private:
+    static uint8_t rxEnable_;
+};
+template<typename Uart, BaudRate baud>
+uint8_t ClockSync<Uart, baud>::rxEnable_;
 
 } // Uarts
 } // Mcudrv
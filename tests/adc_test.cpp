@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// Adcs::ScanEngine and BurstEngine on the simulated ADC1: channel inputs are set with Host::SetAdcInput,
+// every Host::AdcConvert completes one scan of channels 0..max (scan mode) or fills the data buffer
+// with the selected channel (buffered continuous mode).
+
+#include "adc_scan.h"
+#include "check.h"
+
+using namespace Mcudrv;
+using namespace Mcudrv::Adcs;
+
+namespace {
+
+typedef ScanEngine<3, Ch4, Ch2> Engine;
+typedef BurstEngine<Ch4, Ch2, Ch6> Bursts;
+
+// Conversions (EOC interrupts) a burst took
+template<typename Adc>
+unsigned Burst()
+{
+    unsigned eocs = 0;
+    Adc::Start();
+    while(Adc::IsBusy() && eocs < 100) {
+        Host::AdcConvert();
+        ++eocs;
+    }
+    return eocs;
+}
+
+} // namespace
+
+int main()
+{
+    Host::Reset();
+    Host::AttachIsr(ADC1_EOC_vector, Engine::EocISR);
+    __enable_interrupt();
+
+    Engine::Init<Div2>();
+    CHECK((ADC1->CR2 & ADC1_CR2_SCAN) && (ADC1->CR3 & ADC1_CR3_DBUF) && (ADC1->CSR & 0x0F) == 4);
+    CHECK(ADC1->TDRL == (1 << 4 | 1 << 2) && !(ADC1->CR1 & ADC1_CR1_ADON));
+
+    // 2^3 scans a burst, the ADC is off again when the set is published
+    Host::SetAdcInput(2, 100);
+    Host::SetAdcInput(3, 555); // converted by the scan, but not listed
+    Host::SetAdcInput(4, 1000);
+    const uint8_t seq = Engine::GetSequence();
+    CHECK(Burst<Engine>() == 8);
+    CHECK(Engine::GetSequence() == uint8_t(seq + 1) && !(ADC1->CR1 & ADC1_CR1_ADON));
+    CHECK(Engine::GetSum<Ch4>() == 8000 && Engine::GetSum<Ch2>() == 800);
+    CHECK(Engine::GetAverage<Ch2>() == 100 && Engine::GetAverage<Ch4>() == 1000);
+    uint16_t sums[2];
+    Engine::Snapshot(sums);
+    CHECK(sums[0] == 8000 && sums[1] == 800);
+
+    // Start() during a burst is ignored, the full scale sum fits
+    Host::SetAdcInput(4, 0x3FF);
+    Engine::Start();
+    CHECK(Burst<Engine>() == 8 && Engine::GetSequence() == uint8_t(seq + 2));
+    CHECK(Engine::GetSum<Ch4>() == Engine::MaxSum);
+    // The previous set stays readable until the next one is complete
+    Host::SetAdcInput(2, 0);
+    Engine::Start();
+    Host::AdcConvert();
+    CHECK(Engine::IsBusy() && Engine::GetSum<Ch2>() == 800);
+    while(Engine::IsBusy()) {
+        Host::AdcConvert();
+    }
+    CHECK(!Engine::GetSum<Ch2>());
+
+    // Buffered bursts: 10 samples of a channel an interrupt, one interrupt per channel
+    Host::Reset();
+    Host::AttachIsr(ADC1_EOC_vector, Bursts::EocISR);
+    __enable_interrupt();
+    Bursts::Init<Div2>();
+    CHECK((ADC1->CR1 & ADC1_CR1_CONT) && (ADC1->CR3 & ADC1_CR3_DBUF) && !(ADC1->CR2 & ADC1_CR2_SCAN));
+    CHECK((ADC1->CSR & 0x0F) == 4 && ADC1->TDRL == (1 << 6 | 1 << 4 | 1 << 2));
+    Host::SetAdcInput(2, 100);
+    Host::SetAdcInput(4, 1000);
+    Host::SetAdcInput(6, 0x3FF);
+    const uint8_t bseq = Bursts::GetSequence();
+    CHECK(Burst<Bursts>() == 3 && Bursts::GetSequence() == uint8_t(bseq + 1));
+    CHECK(Bursts::GetSum<Ch4>() == 10000 && Bursts::GetSum<Ch2>() == 1000 && Bursts::GetSum<Ch6>() == Bursts::MaxSum);
+    CHECK(Bursts::GetAverage<Ch2>() == 100 && Bursts::GetAverage<Ch6>() == 0x3FF);
+    CHECK(!(ADC1->CR1 & ADC1_CR1_ADON) && (ADC1->CSR & 0x0F) == 4);
+    uint16_t burstSums[3];
+    Host::SetAdcInput(2, 7);
+    Bursts::Start();
+    Host::AdcConvert();
+    Bursts::Snapshot(burstSums);
+    CHECK(burstSums[0] == 10000 && burstSums[1] == 1000 && burstSums[2] == Bursts::MaxSum);
+    Host::AdcConvert();
+    Host::AdcConvert();
+    Bursts::Snapshot(burstSums);
+    CHECK(!Bursts::IsBusy() && burstSums[1] == 70);
+
+    return Test::Result("adc");
+}
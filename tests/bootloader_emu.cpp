@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// Bootloader emulator: runs the bootloader on the master side of a pseudo-terminal,
+// so the flashing tool can be pointed at the slave path printed on start.
+// Usage: bootloader_emu [-r] [-b baud] [-o image.bin]
+//   -r  program flash in real time (6 ms per byte, word or block, see FlashSim)
+//   -b  pace the replies at the baud rate (10 bits a byte)
+//   -o  save the flash image (0x8000-0xFFFF) when the application is started or on Ctrl-C
+// The session ends when the tool starts the application (C_GO) or hangs up.
+
+#include "bootloader_sim.h"
+#include <fcntl.h>
+#include <pty.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+
+using namespace Sim;
+
+namespace {
+
+typedef Bootloader<ID_STM8S103F3, 9600UL, Pd6, FlashSim, FdLink> Boot;
+
+struct Started
+{
+    uint16_t addr;
+};
+
+const char* imagePath;
+
+// Flash image 0x8000-0xFFFF, with async-signal-safe calls only as it's used on Ctrl-C as well
+void Save()
+{
+    if(!imagePath) {
+        return;
+    }
+    const int fd = open(imagePath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0 || write(fd, &FlashSim::mem[0x8000], 0x8000) != 0x8000) {
+        const char msg[] = "bootloader_emu: image not saved\n";
+        write(2, msg, sizeof(msg) - 1);
+    }
+    if(fd >= 0) {
+        close(fd);
+    }
+}
+
+void OnJump(uint16_t addr)
+{
+    Started s = { addr };
+    throw s;
+}
+
+void OnSignal(int)
+{
+    Save();
+    _exit(1);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int opt;
+    unsigned long baud = 0;
+    while((opt = getopt(argc, argv, "rb:o:")) != -1) {
+        switch(opt) {
+        case 'r':
+            FlashSim::realTime = true;
+            break;
+        case 'b':
+            baud = strtoul(optarg, 0, 10);
+            break;
+        case 'o':
+            imagePath = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-r] [-b baud] [-o image.bin]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    int master, slave;
+    char name[64];
+    if(openpty(&master, &slave, name, 0, 0)) {
+        perror("openpty");
+        return 1;
+    }
+    termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    printf("%s\n", name);
+    fflush(stdout);
+
+    Host::Reset();
+    Host::SetJumpCallback(OnJump);
+    FlashSim::Reset();
+    FdLink::fd = master;
+    FdLink::byteTimeUs = baud ? 10 * 1000000UL / baud : 0;
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+
+    // The slave stays open here, so the tool may reconnect until it starts the application
+    try {
+        while(!Boot::ProcessHandshake()) {
+        }
+        Boot::Init();
+        Boot::Process();
+    }
+    catch(Started& s) {
+        printf("application started at 0x%04X\n", s.addr);
+        Save();
+        return 0;
+    }
+    catch(FdLink::Closed&) {
+    }
+    Save();
+    return 1;
+}
@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// Host side of the bootloader: simulated flash with the STM8S programming times (FlashSim),
+// a Transport over a file descriptor, e.g. a pseudo-terminal (FdLink), and the Wake frames
+// as the flashing tool sends and reads them. Shared by bootloader_test and bootloader_emu,
+// the header defines static members, so it's included by one translation unit of a program.
+// The bootloader reads multibyte fields of the packets as words, so they are big-endian on STM8 and
+// in the byte order of the host CPU here (see Native16).
+
+#pragma once
+#ifndef BOOTLOADER_SIM_H
+#define BOOTLOADER_SIM_H
+
+#include "bootloader.h"
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+namespace Sim {
+
+using namespace Mcudrv;
+using namespace Mcudrv::Wk;
+
+// Flash/EEPROM image with the timing of standard programming (erase + write):
+// tPROG = 6 ms for a byte, a word or a whole block alike, so the layout of a write decides its time.
+// In real time mode every operation also takes that long.
+struct FlashSim
+{
+    enum
+    {
+        BLOCK_SIZE = 64,
+        ProgTimeUs = 6000
+    };
+    static uint8_t mem[0x10000];
+    static uint8_t programmed[0x10000]; // times each byte was programmed
+    static bool unlocked;
+    static bool realTime;
+    static unsigned bytes, words, blocks, misaligned;
+    static unsigned long timeUs;
+
+    static void Reset()
+    {
+        memset(mem, 0, sizeof(mem));
+        unlocked = false;
+        Clear();
+    }
+    // Statistics only, the image stays
+    static void Clear()
+    {
+        memset(programmed, 0, sizeof(programmed));
+        bytes = words = blocks = misaligned = 0;
+        timeUs = 0;
+    }
+    static void Unlock()
+    {
+        unlocked = true;
+    }
+    static void Lock()
+    {
+        unlocked = false;
+    }
+    static uint8_t Read(uint16_t addr)
+    {
+        return mem[addr];
+    }
+    static void WriteByte(uint16_t addr, uint8_t value)
+    {
+        ++bytes;
+        Program(addr, &value, 1);
+    }
+    static void WriteWord(uint16_t addr, const uint8_t* data)
+    {
+        ++words;
+        misaligned += addr % 4 != 0;
+        Program(addr, data, 4);
+    }
+    static void WriteBlock(uint16_t addr, const uint8_t* data)
+    {
+        ++blocks;
+        misaligned += addr % BLOCK_SIZE != 0;
+        Program(addr, data, BLOCK_SIZE);
+    }
+
+private:
+    static void Program(uint16_t addr, const uint8_t* data, uint8_t len)
+    {
+        if(!unlocked) {
+            return;
+        }
+        memcpy(&mem[addr], data, len);
+        for(uint8_t i = 0; i < len; ++i) {
+            ++programmed[uint16_t(addr + i)];
+        }
+        timeUs += ProgTimeUs;
+        if(realTime) {
+            const timespec t = { 0, ProgTimeUs * 1000L };
+            nanosleep(&t, 0);
+        }
+    }
+};
+uint8_t FlashSim::mem[0x10000];
+uint8_t FlashSim::programmed[0x10000];
+bool FlashSim::unlocked;
+bool FlashSim::realTime;
+unsigned FlashSim::bytes, FlashSim::words, FlashSim::blocks, FlashSim::misaligned;
+unsigned long FlashSim::timeUs;
+
+// Transport over a file descriptor in raw mode. Getch() throws Closed at the end of the stream,
+// byteTimeUs paces the transmitter at the line rate (0 - as fast as the descriptor takes it).
+struct FdLink
+{
+    struct Closed
+    { };
+    enum
+    {
+        BaseAddr = UART1_BaseAddress
+    };
+    static int fd;
+    static unsigned long byteTimeUs;
+
+    template<Uarts::Cfg, Uarts::BaudRate>
+    static void Init()
+    { }
+    // Waits up to 100 ms for a byte, a hang up is reported as one so Getch() throws
+    static bool IsEvent(const Uarts::Events ev)
+    {
+        if(ev == Uarts::EvTxComplete) {
+            return true;
+        }
+        if(ev != Uarts::EvRxne) {
+            return false;
+        }
+        pollfd p = { fd, POLLIN, 0 };
+        return poll(&p, 1, 100) > 0;
+    }
+    static uint8_t Getch()
+    {
+        uint8_t c;
+        ssize_t n;
+        do {
+            n = read(fd, &c, 1);
+        } while(n < 0 && errno == EINTR);
+        if(n != 1) {
+            throw Closed();
+        }
+        return c;
+    }
+    static void Putch(const uint8_t c)
+    {
+        if(write(fd, &c, 1) != 1) {
+            throw Closed();
+        }
+        if(byteTimeUs) {
+            const timespec t = { 0, long(byteTimeUs * 1000) };
+            nanosleep(&t, 0);
+        }
+    }
+};
+int FdLink::fd = -1;
+unsigned long FdLink::byteTimeUs;
+
+// ---=== Flashing tool side ===---
+
+struct Reply
+{
+    bool valid;
+    uint8_t cmd;
+    std::vector<uint8_t> data;
+};
+
+inline void PutStuffed(std::vector<uint8_t>& out, uint8_t c)
+{
+    if(c == FEND) {
+        out.push_back(FESC);
+        out.push_back(TFEND);
+    }
+    else if(c == FESC) {
+        out.push_back(FESC);
+        out.push_back(TFESC);
+    }
+    else {
+        out.push_back(c);
+    }
+}
+
+inline std::vector<uint8_t> Frame(uint8_t cmd, const std::vector<uint8_t>& data, bool badCrc = false)
+{
+    Crc::BOOTLOADER_CRC crc;
+    crc.Reset(CRC_INIT)(FEND);
+    std::vector<uint8_t> out(1, FEND);
+    const uint8_t header[] = { BOOTADDRESS | 0x80, cmd, uint8_t(data.size()) };
+    for(size_t i = 0; i < sizeof(header); ++i) {
+        crc(header[i]);
+        PutStuffed(out, header[i]);
+    }
+    for(size_t i = 0; i < data.size(); ++i) {
+        crc(data[i]);
+        PutStuffed(out, data[i]);
+    }
+    PutStuffed(out, uint8_t(crc.GetResult() ^ badCrc));
+    return out;
+}
+
+// Unstuffed frame after FEND: address, command, n, data, CRC
+inline std::vector<uint8_t> Unstuff(const std::vector<uint8_t>& in)
+{
+    std::vector<uint8_t> raw;
+    for(size_t i = 1; i < in.size(); ++i) {
+        if(in[i] == FESC && i + 1 < in.size()) {
+            raw.push_back(in[++i] == TFEND ? FEND : FESC);
+        }
+        else {
+            raw.push_back(in[i]);
+        }
+    }
+    return raw;
+}
+
+inline Reply Parse(const std::vector<uint8_t>& in)
+{
+    Reply r = { false, 0, std::vector<uint8_t>() };
+    if(in.empty() || in[0] != FEND) {
+        return r;
+    }
+    const std::vector<uint8_t> raw = Unstuff(in);
+    if(raw.size() < 4 || raw[0] != (BOOTADDRESS | 0x80) || raw[2] != raw.size() - 4) {
+        return r;
+    }
+    Crc::BOOTLOADER_CRC crc;
+    crc.Reset(CRC_INIT)(FEND);
+    for(size_t i = 0; i + 1 < raw.size(); ++i) {
+        crc(raw[i]);
+    }
+    r.valid = crc.GetResult() == raw.back();
+    r.cmd = raw[1];
+    r.data.assign(raw.begin() + 3, raw.end() - 1);
+    return r;
+}
+
+// Reads one frame from the descriptor, an invalid reply on timeout or end of stream
+inline Reply ReadFrame(int fd, int timeoutMs = 1000)
+{
+    std::vector<uint8_t> in;
+    while(true) {
+        pollfd p = { fd, POLLIN, 0 };
+        uint8_t c;
+        if(poll(&p, 1, timeoutMs) <= 0 || read(fd, &c, 1) != 1) {
+            return Parse(std::vector<uint8_t>());
+        }
+        if(c == FEND) {
+            in.assign(1, c);
+            continue;
+        }
+        if(in.empty()) {
+            continue;
+        }
+        in.push_back(c);
+        const std::vector<uint8_t> raw = Unstuff(in);
+        if(in.back() != FESC && raw.size() >= 4 && raw.size() == raw[2] + 4U) {
+            return Parse(in);
+        }
+    }
+}
+
+inline std::vector<uint8_t> Native16(uint16_t value)
+{
+    std::vector<uint8_t> out(2);
+    memcpy(&out[0], &value, 2);
+    return out;
+}
+inline uint16_t Native16(const uint8_t* p)
+{
+    uint16_t value;
+    memcpy(&value, p, 2);
+    return value;
+}
+
+} // Sim
+
+#endif // BOOTLOADER_SIM_H
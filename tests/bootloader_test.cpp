@@ -0,0 +1,355 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// Bootloader protocol test on the host: Wake frames are fed through a scripted Transport and
+// the flash is a memory image with the programming times of STM8S (bootloader_sim.h).
+// Besides the protocol cases, every packet size is written at every alignment within a block,
+// and the flashing tool is run against the bootloader over a pseudo-terminal.
+
+#include <thread> // ahead of the drivers, stm8s.h defines nullptr for the old compiler
+#include "bootloader_sim.h"
+#include "check.h"
+#include <pty.h>
+#include <stdio.h>
+#include <string.h>
+#include <termios.h>
+#include <vector>
+
+using namespace Sim;
+
+namespace {
+
+// Byte link, Getch() ends the bootloader loop by throwing Idle when the script is over
+struct Link
+{
+    struct Idle
+    { };
+    enum
+    {
+        BaseAddr = UART1_BaseAddress
+    };
+    static std::vector<uint8_t> rx, tx;
+    static size_t rxPos;
+
+    template<Uarts::Cfg, Uarts::BaudRate>
+    static void Init()
+    { }
+    static bool IsEvent(const Uarts::Events ev)
+    {
+        return (ev == Uarts::EvRxne && rxPos < rx.size()) || ev == Uarts::EvTxComplete;
+    }
+    static uint8_t Getch()
+    {
+        if(rxPos == rx.size()) {
+            throw Idle();
+        }
+        return rx[rxPos++];
+    }
+    static void Putch(const uint8_t c)
+    {
+        tx.push_back(c);
+    }
+};
+std::vector<uint8_t> Link::rx, Link::tx;
+size_t Link::rxPos;
+
+typedef Bootloader<ID_STM8S103F3, 9600UL, Pd6, FlashSim, Link> Boot;
+typedef BootTraits<ID_STM8S103F3> Traits;
+
+uint16_t jumpAddr;
+void OnJump(uint16_t addr)
+{
+    jumpAddr = addr;
+}
+
+// Runs the bootloader over the frames until the link is idle, returns the last reply
+Reply Session(const std::vector<uint8_t>& frames)
+{
+    Link::rx = frames;
+    Link::rxPos = 0;
+    Link::tx.clear();
+    try {
+        Boot::Process();
+    }
+    catch(Link::Idle&) {
+    }
+    return Parse(Link::tx);
+}
+
+Reply Request(uint8_t cmd, const std::vector<uint8_t>& data)
+{
+    return Session(Frame(cmd, data));
+}
+
+Reply SetPosition(uint16_t offset)
+{
+    return Request(C_SETPOSITION, Native16(offset));
+}
+
+// Writes the image in packets of up to maxPacket bytes from the current position
+bool Write(const std::vector<uint8_t>& image, size_t maxPacket)
+{
+    for(size_t pos = 0; pos < image.size(); pos += maxPacket) {
+        const size_t len = image.size() - pos < maxPacket ? image.size() - pos : maxPacket;
+        Reply r = Request(C_WRITE, std::vector<uint8_t>(image.begin() + pos, image.begin() + pos + len));
+        if(!r.valid || r.data.size() != 3 || r.data[0] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Program operations WriteFlash() needs for a packet: bytes up to a word, words up to a block,
+// blocks, then words and bytes of the tail
+unsigned PacketOps(unsigned addr, unsigned len)
+{
+    unsigned ops = 0;
+    for(; addr % 4 && len; ++addr, --len, ++ops) {
+    }
+    for(; addr % FlashSim::BLOCK_SIZE && len >= 4; addr += 4, len -= 4, ++ops) {
+    }
+    ops += len / FlashSim::BLOCK_SIZE + len % FlashSim::BLOCK_SIZE / 4 + len % 4;
+    return ops;
+}
+
+// Every packet size at every offset within a block: the image must land intact with each byte
+// programmed once, by aligned operations only, in the time of the operations WriteFlash() makes
+void Sweep(const std::vector<uint8_t>& image)
+{
+    unsigned failed = 0;
+    for(unsigned packet = 1; packet <= WAKEDATABUFSIZE; ++packet) {
+        for(unsigned align = 0; align < FlashSim::BLOCK_SIZE; ++align) {
+            const uint16_t offset = 0x400 + align;
+            const uint16_t addr = Traits::FlashStart + offset;
+            memset(&FlashSim::mem[addr - FlashSim::BLOCK_SIZE], 0, image.size() + 2 * FlashSim::BLOCK_SIZE);
+            SetPosition(offset);
+            FlashSim::Clear();
+            unsigned ops = 0;
+            for(unsigned pos = 0; pos < image.size(); pos += packet) {
+                ops += PacketOps(addr + pos, image.size() - pos < packet ? image.size() - pos : packet);
+            }
+            bool ok = Write(image, packet) && !memcmp(&FlashSim::mem[addr], &image[0], image.size());
+            for(unsigned i = addr - FlashSim::BLOCK_SIZE; i < addr + image.size() + FlashSim::BLOCK_SIZE; ++i) {
+                ok &= FlashSim::programmed[i] == (i >= addr && i < addr + image.size());
+            }
+            ok &= FlashSim::bytes + FlashSim::words * 4 + FlashSim::blocks * FlashSim::BLOCK_SIZE == image.size();
+            ok &= !FlashSim::misaligned;
+            ok &= FlashSim::bytes + FlashSim::words + FlashSim::blocks == ops;
+            ok &= FlashSim::timeUs == ops * (unsigned long)FlashSim::ProgTimeUs;
+            if(!ok && failed++ < 5) {
+                printf("sweep: packet %u at offset 0x%X failed\n", packet, offset);
+            }
+        }
+    }
+    CHECK(!failed);
+}
+
+// Flash time of a 1 KB image for a few packet sizes and alignments, with the line time at 9600 baud
+// (10 bits a byte, stuffing included, both directions)
+void TimingTable()
+{
+    std::vector<uint8_t> image(1024, 0x55);
+    static const unsigned packets[] = { 16, 32, 64, 128, 140 };
+    static const unsigned aligns[] = { 0, 1, 4, 32 };
+    printf("bootloader: 1 KB flash ms (+ line ms at 9600) by packet size / block offset\n");
+    for(unsigned p = 0; p < sizeof(packets) / sizeof(packets[0]); ++p) {
+        printf("  %3u:", packets[p]);
+        for(unsigned a = 0; a < sizeof(aligns) / sizeof(aligns[0]); ++a) {
+            SetPosition(0x400 + aligns[a]);
+            FlashSim::Clear();
+            unsigned long wire = 0;
+            for(size_t pos = 0; pos < image.size(); pos += packets[p]) {
+                const size_t len = image.size() - pos < packets[p] ? image.size() - pos : packets[p];
+                Request(C_WRITE, std::vector<uint8_t>(image.begin() + pos, image.begin() + pos + len));
+                wire += Link::rx.size() + Link::tx.size();
+            }
+            printf("  +%-2u %4lu (+%4lu)", aligns[a], FlashSim::timeUs / 1000, wire * 10 * 1000 / 9600);
+        }
+        printf("\n");
+    }
+}
+
+typedef Bootloader<ID_STM8S103F3, 9600UL, Pd6, FlashSim, FdLink> PtyBoot;
+
+// Bootloader on the master side of a pseudo-terminal, talks until the tool hangs up
+void PtyTarget()
+{
+    try {
+        while(!PtyBoot::ProcessHandshake()) {
+        }
+        PtyBoot::Init();
+        PtyBoot::Process();
+    }
+    catch(FdLink::Closed&) {
+    }
+}
+
+bool PtyRequest(int fd, uint8_t cmd, const std::vector<uint8_t>& data, Reply& r)
+{
+    const std::vector<uint8_t> frame = Frame(cmd, data);
+    if(write(fd, &frame[0], frame.size()) != ssize_t(frame.size())) {
+        return false;
+    }
+    r = ReadFrame(fd);
+    return r.valid && r.cmd == cmd && !r.data.empty() && r.data[0] == 0;
+}
+
+// The flashing tool on the slave side: handshake, info, 1 KB image in odd sized packets, read back, run
+void PtySession(const std::vector<uint8_t>& image)
+{
+    int master, slave;
+    CHECK(!openpty(&master, &slave, 0, 0, 0));
+    termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    FlashSim::Reset();
+    jumpAddr = 0;
+    FdLink::fd = master;
+    std::thread target(PtyTarget);
+
+    const uint8_t key = BOOTSTART_KEY;
+    uint8_t response = 0;
+    CHECK(write(slave, &key, 1) == 1);
+    pollfd p = { slave, POLLIN, 0 };
+    CHECK(poll(&p, 1, 1000) > 0 && read(slave, &response, 1) == 1 && response == BOOTRESPONSE);
+    Reply r;
+    CHECK(PtyRequest(slave, C_GETINFO, std::vector<uint8_t>(1, BOOTLOADER_KEY), r) && r.data.size() == 3);
+    CHECK(PtyRequest(slave, C_SETPOSITION, Native16(uint16_t(0)), r));
+    for(size_t pos = 0; pos < image.size(); pos += 100) {
+        const size_t len = image.size() - pos < 100 ? image.size() - pos : 100;
+        CHECK(PtyRequest(slave, C_WRITE, std::vector<uint8_t>(image.begin() + pos, image.begin() + pos + len), r));
+    }
+    CHECK(PtyRequest(slave, C_SETPOSITION, Native16(uint16_t(0)), r));
+    std::vector<uint8_t> readBack;
+    while(readBack.size() < image.size() && PtyRequest(slave, C_READ, std::vector<uint8_t>(1, 128), r)) {
+        readBack.insert(readBack.end(), r.data.begin() + 3, r.data.end());
+    }
+    CHECK(readBack == image);
+    const std::vector<uint8_t> go = Frame(C_GO, std::vector<uint8_t>(1, BOOTLOADER_KEY));
+    CHECK(write(slave, &go[0], go.size()) == ssize_t(go.size()));
+    ReadFrame(slave); // not ready reply after the host jump returns
+    CHECK(jumpAddr == UBC_END);
+    close(slave);
+    target.join();
+    close(master);
+}
+
+} // namespace
+
+int main()
+{
+    Host::Reset();
+    Host::SetJumpCallback(OnJump);
+    FlashSim::Reset();
+
+    // Handshake
+    Link::rx.assign(1, BOOTSTART_KEY);
+    Link::rxPos = 0;
+    CHECK(Boot::ProcessHandshake());
+    CHECK(Link::tx.size() == 1 && Link::tx[0] == BOOTRESPONSE);
+    Link::tx.clear();
+    Boot::Init();
+    CHECK(FlashSim::unlocked);
+
+    // Info
+    Reply r = Request(C_GETINFO, std::vector<uint8_t>(1, BOOTLOADER_KEY));
+    CHECK(r.valid && r.cmd == C_GETINFO && r.data.size() == 3);
+    CHECK(r.data[0] == 0 && r.data[1] == (ID_STM8S103F3 << 4 | BOOTLOADER_VER));
+    CHECK(r.data[2] == (Traits::FlashStart - 0x8000) / 64);
+    r = Request(C_GETINFO, std::vector<uint8_t>(1, 0));
+    CHECK(r.valid && r.data.size() == 1 && r.data[0] != 0);
+
+    // No application yet
+    r = Request(C_GO, std::vector<uint8_t>(1, BOOTLOADER_KEY));
+    CHECK(r.valid && r.data.size() == 1 && r.data[0] != 0 && !jumpAddr);
+
+    // Corrupted and foreign frames are dropped silently, unknown commands are rejected
+    CHECK(!Session(Frame(C_GETINFO, std::vector<uint8_t>(1, BOOTLOADER_KEY), true)).valid);
+    CHECK(Link::tx.empty());
+    r = Request(0x40, std::vector<uint8_t>());
+    CHECK(r.valid && r.cmd == C_ERR && r.data.size() == 1 && r.data[0] != 0);
+
+    // 1 KB application, block aligned: programmed by blocks only.
+    // The image has every byte value, so FEND and FESC are stuffed on the way in and out.
+    std::vector<uint8_t> image(1024);
+    for(size_t i = 0; i < image.size(); ++i) {
+        image[i] = uint8_t(i * 7 + (i >> 8));
+    }
+    image[0] = 0x82; // INT opcode, the application check of Go()
+    r = SetPosition(0);
+    CHECK(r.valid && r.data.size() == 3 && Native16(&r.data[1]) == Traits::FlashStart);
+    FlashSim::Clear();
+    CHECK(Write(image, 128));
+    CHECK(!memcmp(&FlashSim::mem[Traits::FlashStart], &image[0], image.size()));
+    CHECK(FlashSim::blocks == image.size() / FlashSim::BLOCK_SIZE && !FlashSim::words && !FlashSim::bytes);
+    CHECK(FlashSim::timeUs == image.size() / FlashSim::BLOCK_SIZE * FlashSim::ProgTimeUs);
+    const unsigned long blockTime = FlashSim::timeUs;
+
+    // Unaligned start: bytes up to a word, words up to a block, then blocks and the tail
+    std::vector<uint8_t> patch(137);
+    for(size_t i = 0; i < patch.size(); ++i) {
+        patch[i] = uint8_t(0xC0 + i);
+    }
+    const uint16_t patchOffset = 0x402;
+    SetPosition(patchOffset);
+    FlashSim::Clear();
+    CHECK(Write(patch, patch.size()));
+    CHECK(!memcmp(&FlashSim::mem[Traits::FlashStart + patchOffset], &patch[0], patch.size()));
+    CHECK(!FlashSim::misaligned);
+    CHECK(FlashSim::bytes == 2 + 3 && FlashSim::words == 15 + 2 && FlashSim::blocks == 1);
+
+    // Read back through the link, the position advances
+    SetPosition(0);
+    std::vector<uint8_t> readBack;
+    for(uint8_t i = 0; i < 8; ++i) {
+        r = Request(C_READ, std::vector<uint8_t>(1, 128));
+        CHECK(r.valid && r.data.size() == 128 + 3 && r.data[0] == 0);
+        CHECK(Native16(&r.data[1]) == Traits::FlashStart + (i + 1) * 128U);
+        readBack.insert(readBack.end(), r.data.begin() + 3, r.data.end());
+    }
+    CHECK(readBack == image);
+    r = Request(C_READ, std::vector<uint8_t>(1, 129));
+    CHECK(r.valid && r.data.size() == 1 && r.data[0] != 0);
+
+    // EEPROM position and out of range addresses
+    r = SetPosition(0x8000 | 0x10);
+    CHECK(r.valid && r.data.size() == 3 && Native16(&r.data[1]) == Traits::EepromStart + 0x10);
+    r = SetPosition(Traits::FlashSize);
+    CHECK(r.valid && r.data.size() == 1 && r.data[0] != 0);
+
+    // Application present: flash is locked and the control goes to it
+    r = Request(C_GO, std::vector<uint8_t>(1, BOOTLOADER_KEY));
+    CHECK(jumpAddr == UBC_END && !FlashSim::unlocked);
+
+    // By words the same image would take 16 times longer
+    printf("bootloader: 1 KB programmed in %lu ms by blocks (%lu ms by words)\n", blockTime / 1000,
+           blockTime / 1000 * (FlashSim::BLOCK_SIZE / 4));
+
+    Boot::Init();
+    Sweep(std::vector<uint8_t>(image.begin(), image.begin() + 3 * FlashSim::BLOCK_SIZE + 7));
+    TimingTable();
+    PtySession(image);
+    return Test::Result("bootloader");
+}
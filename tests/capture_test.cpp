@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// Capture::PeriodMeter on the simulated TIM1/TIM2: edges are injected with Host::TimerCapture
+// between counter ticks of Host::AdvanceTimers, interrupts are served in the STM8 vector order
+// (update before capture/compare).
+
+#include "capture.h"
+#include "check.h"
+
+using namespace Mcudrv;
+
+namespace {
+
+typedef Capture::PeriodMeter<T1::Timer1, Timers::Ch1, 2, 3> Meter1;
+typedef Capture::PeriodMeter<T2::Timer2, Timers::Ch1, 0, 3> Meter2;
+typedef Capture::PeriodMeter<T1::Timer1, Timers::Ch3, 0, 3> Meter3;
+
+void Capture1()
+{
+    Meter1::CaptureIRQ();
+}
+void Update1()
+{
+    Meter1::UpdateIRQ();
+}
+void Capture2()
+{
+    Meter2::CaptureIRQ();
+}
+void Update2()
+{
+    Meter2::UpdateIRQ();
+}
+
+void Capture3()
+{
+    Meter3::CaptureIRQ();
+}
+void Update3()
+{
+    Meter3::UpdateIRQ();
+}
+
+void Setup()
+{
+    Host::Reset();
+    Host::AttachIsr(TIM1_CAPCOM_CC1IF_vector, Capture1);
+    Host::AttachIsr(TIM1_OVR_UIF_vector, Update1);
+    Host::AttachIsr(TIM2_CAPCOM_CC1IF_vector, Capture2);
+    Host::AttachIsr(TIM2_OVR_UIF_vector, Update2);
+    __enable_interrupt();
+    T1::Timer1::Init(1, T1::CEN);
+    T2::Timer2::Init(T2::Div_1, T2::CEN);
+    Meter1::Init();
+    Meter2::Init();
+}
+// TIM1 Ch3/Ch4 with a single period average
+void Setup3()
+{
+    Host::Reset();
+    Host::AttachIsr(TIM1_CAPCOM_CC1IF_vector, Capture3);
+    Host::AttachIsr(TIM1_OVR_UIF_vector, Update3);
+    __enable_interrupt();
+    T1::Timer1::Init(1, T1::CEN);
+    Meter3::Init();
+}
+
+// Rising edges at 'first' and 'second' counts of the next counter cycle. The second one is latched
+// with interrupts masked, then the counter wraps, so the update is pending along with the capture.
+template<typename Meter>
+uint32_t PeriodAcrossWrap(uint16_t base, uint8_t ch, uint16_t first, uint16_t second)
+{
+    Host::AdvanceTimers(first);
+    Host::TimerCapture(base, ch);
+    Host::AdvanceTimers(uint32_t(second) - first);
+    __disable_interrupt();
+    Host::TimerCapture(base, ch);
+    Host::AdvanceTimers(0x10000UL - second);
+    __enable_interrupt();
+    Host::Poll();
+    return Meter::GetPeriod();
+}
+
+} // namespace
+
+int main()
+{
+    Setup();
+    CHECK(Meter1::IsStalled());
+    // TIM1: rise on Ch1, fall on Ch2 (both on TI1), period 100000 ticks, high 30000
+    for(int i = 0; i < 12; ++i) {
+        Host::TimerCapture(TIM1_BaseAddress, 0);
+        Host::AdvanceTimers(30000);
+        Host::TimerCapture(TIM1_BaseAddress, 1);
+        Host::AdvanceTimers(70000);
+    }
+    CHECK(Meter1::GetPeriod() == 100000 && Meter1::GetHighTime() == 30000);
+    CHECK(Meter1::GetDuty() == 30 && Meter1::GetRate(1000000UL) == 600);
+
+    // TIM2: both edges pending at once, the fall is older than the rise
+    for(int i = 0; i < 5; ++i) {
+        Host::AdvanceTimers(1000);
+        __disable_interrupt();
+        Host::TimerCapture(TIM2_BaseAddress, 1);
+        Host::AdvanceTimers(234);
+        Host::TimerCapture(TIM2_BaseAddress, 0);
+        __enable_interrupt();
+        Host::Poll();
+    }
+    CHECK(Meter2::GetPeriod() == 1234 && Meter2::GetHighTime() == 1000);
+
+    // No edges for StallOverflows counter cycles
+    Host::AdvanceTimers(3UL * 0x10000);
+    CHECK(Meter1::IsStalled() && Meter2::IsStalled() && Meter1::GetRate(1000000UL) == 0);
+
+    // Capture just before the wrap, served after the update
+    Setup();
+    CHECK(PeriodAcrossWrap<Meter2>(TIM2_BaseAddress, 0, 0x0200, 0xFFF0) == 0xFFF0 - 0x0200);
+    Setup3();
+    CHECK(PeriodAcrossWrap<Meter3>(TIM1_BaseAddress, 2, 0x0200, 0xFFF0) == 0xFFF0 - 0x0200);
+    // and one in the lower half, taken after the wrap
+    Setup3();
+    Host::AdvanceTimers(0x8000);
+    Host::TimerCapture(TIM1_BaseAddress, 2);
+    __disable_interrupt();
+    Host::AdvanceTimers(0x8000 + 0x10);
+    Host::TimerCapture(TIM1_BaseAddress, 2);
+    __enable_interrupt();
+    Host::Poll();
+    CHECK(Meter3::GetPeriod() == 0x10000 - 0x8000 + 0x10);
+    return Test::Result("capture");
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// CircularBuffer SPSC stress: a producer and a consumer thread pass a counting sequence
+// through the element, bulk and span interfaces. The sizes pick both 8 and 16 bit indexes;
+// with 16 bit ones the counters wrap around many times during the run.
+// Threads exercise the host (acquire/release) path of CircularBufferIndex, the interrupt
+// masking of the STM8 multibyte path can't be preempted this way.
+
+#include "circularBuffer.h"
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+
+namespace {
+
+template<size_t Size, typename T>
+bool Stress(const char* name, uint32_t total)
+{
+    typedef CircularBuffer<Size, T> Buffer;
+    typedef typename Buffer::INDEX_T Index;
+    static Buffer cb;
+    bool ok = true;
+    unsigned long full = 0, empty = 0;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::thread producer([&] {
+        T buf[Size / 2 + 3];
+        for(uint32_t next = 0; next < total;) {
+            const uint32_t left = total - next;
+            Index n = 0;
+            switch(next % 3) {
+            case 0:
+                n = cb.Write(T(next));
+                break;
+            case 1: {
+                const uint32_t len = left < sizeof(buf) / sizeof(T) ? left : sizeof(buf) / sizeof(T);
+                for(uint32_t i = 0; i < len; ++i) {
+                    buf[i] = T(next + i);
+                }
+                n = cb.Write(buf, len);
+                break;
+            }
+            default: {
+                T* ptr;
+                n = cb.GetWriteSpan(ptr);
+                if(n > left) {
+                    n = Index(left);
+                }
+                for(Index i = 0; i < n; ++i) {
+                    ptr[i] = T(next + i);
+                }
+                cb.CommitWrite(n);
+            }
+            }
+            if(!n) {
+                ++full;
+                std::this_thread::yield();
+            }
+            next += n;
+        }
+    });
+    std::thread consumer([&] {
+        T buf[Size / 3 + 1];
+        for(uint32_t expected = 0; expected < total;) {
+            Index n = 0;
+            switch(expected % 3) {
+            case 0: {
+                T value;
+                if(cb.Read(value)) {
+                    ok &= value == T(expected);
+                    n = 1;
+                }
+                break;
+            }
+            case 1:
+                n = cb.Read(buf, sizeof(buf) / sizeof(T));
+                for(Index i = 0; i < n; ++i) {
+                    ok &= buf[i] == T(expected + i);
+                }
+                break;
+            default: {
+                const T* ptr;
+                n = cb.GetReadSpan(ptr);
+                for(Index i = 0; i < n; ++i) {
+                    ok &= ptr[i] == T(expected + i);
+                }
+                cb.ConsumeRead(n);
+            }
+            }
+            if(!n) {
+                ++empty;
+                std::this_thread::yield();
+            }
+            expected += n;
+        }
+    });
+    producer.join();
+    consumer.join();
+    ok &= cb.IsEmpty();
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("  %-26s %2u bit index  %lu elements %6.1f ms  full %lu empty %lu  %s\n", name, unsigned(sizeof(Index) * 8),
+           (unsigned long)total, ms, full, empty, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+} // namespace
+
+int main()
+{
+    bool ok = true;
+    printf("circular_buffer: SPSC stress\n");
+    ok &= Stress<128, uint8_t>("CircularBuffer<128>", 2000000);
+    ok &= Stress<256, uint8_t>("CircularBuffer<256>", 2000000);
+    ok &= Stress<512, uint32_t>("CircularBuffer<512, u32>", 2000000);
+    ok &= Stress<1024, uint16_t>("CircularBuffer<1024, u16>", 4000000);
+    printf("circular_buffer: %s\n", ok ? "ok" : "FAILED");
+    return !ok;
+}
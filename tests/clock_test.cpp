@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// Runtime clock switch, built with SYSCLOCK_MAX_SHIFT=3 (2 to 16 MHz): the listeners re-derive the
+// UART divider and the timer prescalers, the delays follow the clock shift. The delays are checked by
+// the NOPs they issue, short ones are made of NOPs only.
+
+#include "clock.h"
+#include "delay.h"
+#include "timers.h"
+#include "uart.h"
+#include "check.h"
+
+using namespace Mcudrv;
+
+namespace {
+
+typedef SysClock::ClockManager<Uarts::ClockSync<Uarts::Uart, 9600>,
+                               Timers::ClockSync<T2::Timer2, 4>,
+                               Timers::ClockSync<T1::Timer1, 100> >
+    Clock;
+
+uint16_t BaudDivider()
+{
+    return uint16_t(UART1->BRR1 << 4 | (UART1->BRR2 & 0xF0) << 8 | (UART1->BRR2 & 0x0F));
+}
+uint16_t Tim1Prescaler()
+{
+    return uint16_t(TIM1->PSCRH << 8 | TIM1->PSCRL);
+}
+unsigned long DelayNops()
+{
+    const unsigned long start = Host::nopCount;
+    delay_cycles<1>();
+    return Host::nopCount - start;
+}
+
+} // namespace
+
+int main()
+{
+    static_assert(SYSCLOCK_MAX_SHIFT == 3, "Build with -DSYSCLOCK_MAX_SHIFT=3");
+    Host::Reset();
+    Uarts::Uart::Init<Uarts::DefaultCfg, 9600>();
+    T2::Timer2::Init(T2::Div_4, T2::CEN);
+    T1::Timer1::Init(100, T1::CEN);
+    CHECK(SysClock::GetShift() == 0 && BaudDivider() == 2000000UL / 9600);
+    CHECK(DelayNops() == 1);
+
+    Clock::Switch<SysClock::Hsi16MHz>();
+    CHECK(SysClock::GetShift() == 3 && SysClock::GetFreq() == 16000000UL && CLK->CKDIVR == 0);
+    CHECK(BaudDivider() == 16000000UL / 9600);
+    CHECK(TIM2->PSCR == T2::Div_32 && Tim1Prescaler() == 800 - 1);
+    CHECK(DelayNops() == 8);
+
+    Clock::Switch<SysClock::Hsi4MHz>();
+    CHECK(SysClock::GetShift() == 1 && BaudDivider() == 4000000UL / 9600);
+    CHECK(TIM2->PSCR == T2::Div_8 && Tim1Prescaler() == 200 - 1);
+    CHECK(DelayNops() == 2);
+
+    Clock::Switch<SysClock::Hsi2MHz>();
+    CHECK(SysClock::GetShift() == 0 && CLK->CKDIVR == (SysClock::Div8 << 3));
+    CHECK(BaudDivider() == 2000000UL / 9600);
+    CHECK(TIM2->PSCR == T2::Div_4 && Tim1Prescaler() == 100 - 1);
+    CHECK(DelayNops() == 1);
+    return Test::Result("clock");
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// CRC engines: check values of the common models with every computation strategy and
+// a comparison of table footprint against speed. Host timings only rank the engines: STM8 cycle
+// counts and code size need the IAR build and aren't measured here, the table column is the flash
+// taken by the lookup table alone.
+
+#include "crc.h"
+#include "check.h"
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+using namespace Mcudrv;
+using Crc::NoLUT::Crc8_Algo1;
+using Crc::NoLUT::Crc8_Algo2;
+
+namespace {
+
+const uint8_t checkString[] = "123456789";
+enum
+{
+    CheckLength = sizeof(checkString) - 1,
+    BenchSize = 4096,
+    BenchRounds = 256,
+    BlockSize = 128 // NoLUT engines take uint8_t length, also the Wake packet size
+};
+uint8_t benchData[BenchSize];
+
+volatile uint32_t sink; // keeps the benchmarked loops alive
+
+// Megabytes per second, fed one byte at a time as the drivers do or by blocks
+template<typename CrcT>
+double Speed(bool block)
+{
+    typedef std::chrono::steady_clock Clock;
+    CrcT crc;
+    crc.Reset();
+    const Clock::time_point start = Clock::now();
+    for(unsigned r = 0; r < BenchRounds; ++r) {
+        if(block) {
+            for(unsigned i = 0; i < BenchSize; i += BlockSize) {
+                crc(benchData + i, BlockSize);
+            }
+        }
+        else {
+            for(unsigned i = 0; i < BenchSize; ++i) {
+                crc(benchData[i]);
+            }
+        }
+        sink = crc.GetResult();
+    }
+    const double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    return double(BenchSize) * BenchRounds / us;
+}
+
+template<typename CrcT>
+void Report(const char* name)
+{
+    printf("  %-20s %5u %8.1f %8.1f\n", name, unsigned(CrcT::TableSize), Speed<CrcT>(false), Speed<CrcT>(true));
+}
+
+template<typename CrcT>
+void Run(const char* name, typename CrcT::value_type check)
+{
+    CHECK(CrcT::Calculate(checkString, CheckLength) == check);
+    // bytewise and block updates agree, also across an unaligned split
+    CrcT a, b;
+    for(unsigned i = 0; i < 1000; ++i) {
+        a(benchData[i]);
+    }
+    b(benchData, 333)(benchData + 333, 1000 - 333);
+    CHECK(a.GetResult() == b.GetResult());
+    Report<CrcT>(name);
+}
+
+template<typename Algo>
+void RunNoLut(const char* name)
+{
+    // Maxim-Dallas, the same check value as Crc::Crc8
+    Crc::NoLUT::Crc8<Algo> crc;
+    crc.Reset()(checkString, CheckLength);
+    CHECK(crc.GetResult() == 0xA1);
+    Crc::Crc8 ref;
+    crc.Reset();
+    for(unsigned i = 0; i < BenchSize; ++i) {
+        crc(benchData[i]);
+        ref(benchData[i]);
+    }
+    CHECK(crc.GetResult() == ref.GetResult());
+    Report<Crc::NoLUT::Crc8<Algo> >(name);
+}
+
+} // namespace
+
+int main()
+{
+    uint32_t seed = 1;
+    for(unsigned i = 0; i < BenchSize; ++i) {
+        seed = seed * 1103515245 + 12345;
+        benchData[i] = uint8_t(seed >> 16);
+    }
+
+    printf("crc: engine               table    MB/s bytewise / block\n");
+    RunNoLut<Crc8_Algo1>("Crc8_NoLUT (Algo1)");
+    RunNoLut<Crc8_Algo2>("Crc8_NoLUT (Algo2)");
+    Run<Crc::Crc8_Bitwise>("Crc8_Bitwise", 0xA1);
+    Run<Crc::Crc8_Nibble>("Crc8_Nibble", 0xA1);
+    Run<Crc::Crc8>("Crc8", 0xA1);
+    Run<Crc::Crc<8, 0x31, 0x00, true, true, 0x00, Crc::Slice4> >("Crc8 Slice4", 0xA1);
+
+    Run<Crc::Crc<16, 0x1021, 0xFFFF, false, false, 0x0000, Crc::Bitwise> >("Crc16Ccitt Bitwise", 0x29B1);
+    Run<Crc::Crc<16, 0x1021, 0xFFFF, false, false, 0x0000, Crc::Nibble> >("Crc16Ccitt Nibble", 0x29B1);
+    Run<Crc::Crc16Ccitt>("Crc16Ccitt", 0x29B1);
+    Run<Crc::Crc16Xmodem>("Crc16Xmodem", 0x31C3);
+    Run<Crc::Crc<16, 0x8005, 0xFFFF, true, true, 0x0000, Crc::Nibble> >("Crc16Modbus Nibble", 0x4B37);
+    Run<Crc::Crc16Modbus>("Crc16Modbus", 0x4B37);
+
+    Run<Crc::Crc<32, 0x04C11DB7, 0xFFFFFFFF, true, true, 0xFFFFFFFF, Crc::Bitwise> >("Crc32 Bitwise", 0xCBF43926);
+    Run<Crc::Crc<32, 0x04C11DB7, 0xFFFFFFFF, true, true, 0xFFFFFFFF, Crc::Nibble> >("Crc32 Nibble", 0xCBF43926);
+    Run<Crc::Crc32>("Crc32", 0xCBF43926);
+    Run<Crc::Crc<32, 0x04C11DB7, 0xFFFFFFFF, true, true, 0xFFFFFFFF, Crc::Slice4> >("Crc32 Slice4", 0xCBF43926);
+    Run<Crc::Crc<32, 0x04C11DB7, 0xFFFFFFFF, true, true, 0xFFFFFFFF, Crc::Slice8> >("Crc32 Slice8", 0xCBF43926);
+
+    return Test::Result("crc");
+}
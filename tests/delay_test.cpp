@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// Internal::Delay<> split, arithmetic only: the code it emits on STM8 is counted with the PM0044
+// timings below and compared with the requested count. It catches a wrong split or overhead constant,
+// the timings themselves (and the aligned placement of DelayLoop) need a run on a simulator or target.
+
+#include "delay.h"
+#include "check.h"
+#include "type_traits.h"
+#include <stdio.h>
+
+using namespace Mcudrv;
+using namespace Mcudrv::Internal;
+
+namespace {
+
+// PM0044 timings of the emitted code, small code model
+enum
+{
+    LdwImm = 2,
+    Call = 4,
+    Ret = 4,
+    Decw = 1,
+    JrneTaken = 2,
+    JrneNotTaken = 1
+};
+
+// One DelayLoop call: LDW X,#n; CALL; n * (DECW X; JRNE); RET
+unsigned long LoopCall(unsigned long loops)
+{
+    return LdwImm + Call + loops * Decw + (loops - 1) * JrneTaken + JrneNotTaken + Ret;
+}
+
+template<unsigned long c>
+unsigned long Model(Delay<c, 0>*)
+{
+    return c; // NOPs
+}
+template<unsigned long c>
+unsigned long Model(Delay<c, 1>*)
+{
+    typedef Delay<c, 1> D;
+    return LoopCall(D::loops) + D::rest;
+}
+template<unsigned long c>
+unsigned long Model(Delay<c, 2>*)
+{
+    return LoopCall(PlatformLoopMax) + Model((Delay<c - PlatformLoopMaxCycles>*)0);
+}
+
+template<unsigned long c>
+unsigned long Cycles()
+{
+    return Model((Delay<c>*)0);
+}
+
+template<unsigned... C>
+void CheckRange(stdx::IndexList<C...>)
+{
+    const unsigned long requested[] = { C... };
+    const unsigned long emitted[] = { Cycles<C>()... };
+    for(unsigned i = 0; i < sizeof...(C); ++i) {
+        CHECK(emitted[i] == requested[i]);
+    }
+}
+
+// delay_ns/delay_us rounding up to whole cycles (delay_us<us> is delay_ns<us * 1000>)
+template<unsigned long ns, unsigned long CpuFreq>
+void Report()
+{
+    enum
+    {
+        cycles = (ns * (CpuFreq / 1000) + 999999UL) / 1000000UL
+    };
+    const double requested = double(ns) * CpuFreq / 1e9;
+    CHECK(Cycles<cycles>() == cycles);
+    CHECK(cycles >= requested && cycles < requested + 1);
+    printf("  %7lu ns @ %2lu MHz: %6lu cycles, rounding %+4.0f ns\n", ns, CpuFreq / 1000000, (unsigned long)cycles,
+           (cycles - requested) * 1e9 / CpuFreq);
+}
+
+} // namespace
+
+int main()
+{
+    // every count up to a few loop iterations, then around the single call limit and beyond
+    CheckRange(stdx::MakeIndexList<600>::type());
+    CHECK(Cycles<PlatformLoopMaxCycles - 1>() == PlatformLoopMaxCycles - 1);
+    CHECK(Cycles<PlatformLoopMaxCycles>() == PlatformLoopMaxCycles);
+    CHECK(Cycles<PlatformLoopMaxCycles + 1>() == PlatformLoopMaxCycles + 1);
+    CHECK(Cycles<PlatformLoopMaxCycles + PlatformLoopMinCycles>() == PlatformLoopMaxCycles + PlatformLoopMinCycles);
+    CHECK(Cycles<1600000>() == 1600000);
+
+    printf("delay: Delay<> split adds up for 0..599 cycles and long delays (PM0044 timings, not measured)\n");
+    Report<250, 2000000>();
+    Report<1000, 2000000>();
+    Report<7000, 2000000>();
+    Report<480000, 2000000>();
+    Report<250, 16000000>();
+    Report<333, 16000000>();
+    Report<1000, 16000000>();
+    Report<7000, 16000000>();
+    Report<480000, 16000000>();
+    return Test::Result("delay");
+}
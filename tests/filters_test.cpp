@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// utils filters against plain reference computations on random data.
+
+#include "filters.h"
+#include "check.h"
+#include <algorithm>
+#include <stdlib.h>
+
+using namespace utils;
+
+int main()
+{
+    MovingAverage<uint16_t, 8> ma;
+    Median<int16_t, 3> m3;
+    Median<int16_t, 5> m5;
+    MinMax<int16_t> mm;
+    uint16_t window[8];
+    int16_t history[5];
+    srand(1);
+    // The first sample fills the filters
+    uint16_t v = rand() % 40000;
+    int16_t s = rand() % 2000 - 1000;
+    std::fill(window, window + 8, v);
+    std::fill(history, history + 5, s);
+    ma.Update(v);
+    m3.Reset(s);
+    m5.Reset(s);
+    mm.Update(s);
+    for(long i = 1; i < 100000; ++i) {
+        v = rand() % 40000;
+        s = rand() % 2000 - 1000;
+        window[i % 8] = v;
+        std::copy(history + 1, history + 5, history);
+        history[4] = s;
+        ma.Update(v);
+        m3.Update(s);
+        m5.Update(s);
+        mm.Update(s);
+        uint32_t sum = 0;
+        for(uint8_t k = 0; k < 8; ++k) {
+            sum += window[k];
+        }
+        int16_t sorted[5];
+        std::copy(history, history + 5, sorted);
+        std::sort(sorted + 2, sorted + 5);
+        const int16_t median3 = sorted[3];
+        std::copy(history, history + 5, sorted);
+        std::sort(sorted, sorted + 5);
+        if(ma.GetSum() != sum || m3.Get() != median3 || m5.Get() != sorted[2]) {
+            CHECK(!"filter output differs from the reference");
+            break;
+        }
+    }
+    CHECK(mm.GetMin() == -1000 && mm.GetMax() == 999);
+
+    // EMA settles on a constant input, the scaled output keeps the fraction bits
+    Ema<uint16_t, 3> ema;
+    for(uint16_t i = 0; i < 200; ++i) {
+        ema.Update(1000);
+    }
+    CHECK(ema.Get() == 1000 && ema.GetScaled<10>() == 10000);
+    ema.Reset(0);
+    ema.Update(7); // state 7/8 of an LSB
+    CHECK(ema.Get() == 0 && ema.GetScaled<8>() == 7 && ema.GetScaled<5>() == 4);
+    Ema<int16_t, 4> negative;
+    for(uint16_t i = 0; i < 300; ++i) {
+        negative.Update(-500);
+    }
+    CHECK(negative.Get() == -500 && negative.GetScaled<2>() == -1000);
+
+    return Test::Result("filters");
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// GPIO and Pinlist on the simulated ports: outputs are checked in ODR and by the pin callback
+// (one report per port and Host::Poll), inputs are driven with Host::SetInput/SetPin.
+
+#include "pinlist.h"
+#include "check.h"
+#include <stdlib.h>
+
+using namespace Mcudrv;
+
+namespace {
+
+typedef Pinlist<Pc3, SequenceOf<4> > Bus;
+// Mixed order over three ports, value bits: Pa1 Pc7 Pa3 Pd2 Pc3 Pd6
+typedef Pinlist<Pa1, Pc7, Pa3, Pd2, Pc3, Pd6> Mixed;
+
+uint8_t odr[9], changed[9], reports[9];
+void OnPins(uint8_t id, uint8_t value, uint8_t mask)
+{
+    odr[id] = value;
+    changed[id] = mask;
+    ++reports[id];
+}
+
+void ClearReports()
+{
+    for(uint8_t i = 0; i < 9; ++i) {
+        changed[i] = reports[i] = 0;
+    }
+}
+
+// Port image the Mixed value must give
+void MixedToPorts(uint8_t v, uint8_t& a, uint8_t& c, uint8_t& d)
+{
+    a = (v & 0x01 ? 0x02 : 0) | (v & 0x04 ? 0x08 : 0);
+    c = (v & 0x02 ? 0x80 : 0) | (v & 0x10 ? 0x08 : 0);
+    d = (v & 0x08 ? 0x04 : 0) | (v & 0x20 ? 0x40 : 0);
+}
+
+} // namespace
+
+int main()
+{
+    Host::Reset();
+    Host::SetPinCallback(OnPins);
+
+    // Contiguous run: one shift of the value, the other bits of the port are kept
+    GPIOC->ODR = 0x81;
+    Bus::SetConfig<GpioBase::Out_PushPull>();
+    CHECK(GPIOC->DDR == 0x78 && GPIOC->CR1 == 0x78);
+    Host::Poll();
+    ClearReports();
+    Bus::Write(0x0A);
+    Host::Poll();
+    CHECK(GPIOC->ODR == (0x81 | 0x0A << 3) && Bus::Read() == 0x0A && Bus::ReadODR() == 0x0A);
+    CHECK(reports[2] == 1 && changed[2] == 0x50 && odr[2] == GPIOC->ODR);
+    Bus::Set(0x01);
+    Bus::Clear(0x08);
+    Bus::Toggle(0x06);
+    Host::Poll();
+    CHECK(Bus::Read() == 0x05 && (GPIOC->ODR & 0x87) == 0x81);
+
+    // Mixed order: every port is written once, the value reads back, foreign pins are untouched
+    Mixed::SetConfig<GpioBase::Out_PushPull>();
+    const uint8_t keepA = 0x04, keepC = 0x10, keepD = 0x02;
+    srand(1);
+    for(uint16_t i = 0; i < 200; ++i) {
+        GPIOA->ODR = uint8_t(rand()) & keepA;
+        GPIOC->ODR = uint8_t(rand()) & keepC;
+        GPIOD->ODR = uint8_t(rand()) & keepD;
+        Host::Poll();
+        ClearReports();
+        const uint8_t v = rand() & 0x3F;
+        uint8_t a, c, d;
+        MixedToPorts(v, a, c, d);
+        const uint8_t a0 = GPIOA->ODR, c0 = GPIOC->ODR, d0 = GPIOD->ODR;
+        Mixed::Write(v);
+        Host::Poll();
+        CHECK(GPIOA->ODR == ((a0 & keepA) | a) && GPIOC->ODR == ((c0 & keepC) | c) && GPIOD->ODR == ((d0 & keepD) | d));
+        CHECK(Mixed::Read() == v);
+        CHECK(reports[0] <= 1 && reports[2] <= 1 && reports[3] <= 1);
+    }
+
+    // Inputs follow SetInput, outputs read back their ODR whatever the input is
+    Pd3::SetConfig<GpioBase::In_float>();
+    Host::SetPin<Pd3>(true);
+    CHECK(Pd3::IsSet());
+    Host::SetPin<Pd3>(false);
+    CHECK(!Pd3::IsSet());
+    Bus::SetConfig<0x03, GpioBase::In_Pullup>();
+    Host::SetInput(Pc3::Port::id, Pc3::mask | Pc4::mask, true);
+    Bus::Write(0x00);
+    Host::Poll();
+    CHECK(Bus::Read() == 0x03 && (GPIOC->DDR & 0x78) == 0x60);
+    Host::SetPin<Pc4>(false);
+    CHECK(Bus::Read() == 0x01);
+
+    // Single pins
+    Pd4::SetConfig<GpioBase::Out_PushPull>();
+    Pd4::Set();
+    Host::Poll();
+    CHECK(Pd4::IsSet() && Pd4::IsODRSet());
+    Pd4::Toggle();
+    Host::Poll();
+    CHECK(!Pd4::IsSet() && !(odr[3] & Pd4::mask));
+    Pd4::SetOrClear(true);
+    InvertedPin<Pd5>::SetConfig<GpioBase::Out_PushPull>();
+    InvertedPin<Pd5>::Set();
+    Host::Poll();
+    CHECK(Pd4::IsSet() && !Pd5::IsODRSet());
+
+    return Test::Result("gpio");
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// Idle manager on the host: Active-halt is simulated by __halt raising the AWU interrupt, the clock
+// is advanced by the ticks slept. The low-power configuration is the one a Wake node gets with
+// WAKE_HALT_WAKEUP_BY_FEND (receiver left out of the busy predicates), the default one keeps the
+// node in WFI while the receiver is on.
+
+#include "idle.h"
+#include "soft_timer.h"
+#include "check.h"
+
+using namespace Mcudrv;
+
+namespace {
+
+typedef SoftTimers::TimerWheel<1> Clock;
+const uint16_t TickFreq = 61;
+const uint16_t WdgTicks = Power::WatchdogSleepTicks<Iwdg::P_1s, TickFreq>::value;
+static_assert(WdgTicks == 46, "3/4 of 1.024s at 61Hz");
+static_assert(Power::WatchdogSleepTicks<Iwdg::P_16ms, TickFreq>::value == 0, "Shorter than a tick");
+
+typedef Power::IdleManager<Clock, TickFreq, Pd6, WdgTicks,
+                           Power::UartTxActive<Uarts::Uart>, Power::NeverActive, Power::PwmActive> LowPower;
+typedef Power::IdleManager<Clock, TickFreq, Pd6, WdgTicks,
+                           Power::UartTxActive<Uarts::Uart>, Power::UartRxEnabled<Uarts::Uart>, Power::PwmActive>
+    Default;
+typedef Power::IdleManager<Clock, TickFreq, Pd6, Power::WatchdogSleepTicks<Iwdg::P_16ms, TickFreq>::value,
+                           Power::NeverActive>
+    ShortWatchdog;
+
+void Timeout()
+{
+}
+
+template<typename Idle>
+bool Halted(uint16_t ticksToNext)
+{
+    Host::AttachIsr(AWU_vector, Idle::AwuISR);
+    Clock::Start(0, ticksToNext, Timeout);
+    IWDG->KR = 0;
+    Idle::SetHaltEnabled(true);
+    Idle::Sleep();
+    return IWDG->KR == 0xAA; // refreshed before halt
+}
+
+} // namespace
+
+int main()
+{
+    Host::Reset();
+    Uarts::Uart::Init<Uarts::DefaultCfg, 9600>();
+    CHECK(Uarts::Uart::Regs()->CR2 & UART1_CR2_REN);
+    LowPower::Init();
+
+    // Halt until a tick before the deadline, capped by the watchdog
+    CHECK(Halted<LowPower>(100));
+    CHECK(Clock::TicksToNext() == 100 - WdgTicks);
+    CHECK(!(AWU->CSR & AWU_CSR_AWUEN));
+    CHECK(Halted<LowPower>(10));
+    CHECK(Clock::TicksToNext() == 1);
+    // A tick left: WFI
+    CHECK(!Halted<LowPower>(1));
+    CHECK(Clock::TicksToNext() == 1);
+
+    // Running PWM keeps the node out of halt
+    TIM2->CR1 |= TIM2_CR1_CEN;
+    CHECK(!Halted<LowPower>(100));
+    TIM2->CR1 &= ~TIM2_CR1_CEN;
+
+    // Default Wake configuration: never halts with the receiver on
+    CHECK(!Halted<Default>(100));
+    CHECK(Clock::TicksToNext() == 100);
+    Uarts::Uart::Regs()->CR2 &= ~UART1_CR2_REN;
+    CHECK(Halted<Default>(100));
+    CHECK(Clock::TicksToNext() == 100 - WdgTicks);
+
+    // Watchdog period shorter than a halt takes
+    CHECK(!Halted<ShortWatchdog>(100));
+    CHECK(Clock::TicksToNext() == 100);
+
+    return Test::Result("idle");
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// RecordQueue against a std::deque model: random pushes (copied and filled in place, committed
+// shorter than reserved) and peeks, with padding at the buffer end and, for the 512 byte queue,
+// a 16 bit index. With DropOldest every failed push makes the next Peek drop the oldest record.
+
+#include "recordQueue.h"
+#include "check.h"
+#include <deque>
+#include <stdio.h>
+#include <vector>
+
+namespace {
+
+typedef std::vector<uint8_t> Record;
+
+template<size_t Size, bool DropOldest>
+void Random(unsigned iterations)
+{
+    typedef RecordQueue<Size, DropOldest> Queue;
+    typedef typename Queue::INDEX_T Index;
+    static Queue queue;
+    std::deque<Record> model;
+    unsigned pendingDrops = 0, failed = 0, dropped = 0;
+    uint32_t seed = 1;
+    for(unsigned it = 0; it < iterations; ++it) {
+        seed = seed * 1103515245UL + 12345;
+        const unsigned r = seed >> 16;
+        if(r % 3) {
+            Record record(r % (Queue::MaxRecordSize + 1));
+            for(size_t i = 0; i < record.size(); ++i) {
+                record[i] = uint8_t(r + i);
+            }
+            bool pushed;
+            if(r & 0x100) {
+                pushed = queue.Push(record.data(), Index(record.size()));
+            }
+            else {
+                uint8_t* ptr = queue.Reserve(Index(record.size() + 1));
+                pushed = ptr != 0 || record.size() == Queue::MaxRecordSize;
+                if(ptr) {
+                    for(size_t i = 0; i < record.size(); ++i) {
+                        ptr[i] = record[i];
+                    }
+                    queue.Commit(Index(record.size()));
+                }
+                else if(pushed) { // doesn't fit with the extra byte reserved
+                    pushed = queue.Push(record.data(), Index(record.size()));
+                }
+            }
+            if(pushed) {
+                model.push_back(record);
+            }
+            else {
+                ++failed;
+                pendingDrops += DropOldest;
+            }
+        }
+        else {
+            for(; pendingDrops && !model.empty(); --pendingDrops, ++dropped) {
+                model.pop_front();
+            }
+            pendingDrops = 0;
+            Index len;
+            const uint8_t* ptr = queue.Peek(len);
+            CHECK((ptr != 0) == !model.empty());
+            if(!ptr) {
+                continue;
+            }
+            CHECK(len == model.front().size() && !memcmp(ptr, model.front().data(), len));
+            model.pop_front();
+            queue.Release();
+        }
+    }
+    CHECK(failed != 0 && (!DropOldest || dropped != 0));
+    printf("  RecordQueue<%zu%s>  %u failed pushes, %u dropped\n", Size, DropOldest ? ", DropOldest" : "",
+           failed, dropped);
+}
+
+} // namespace
+
+int main()
+{
+    Random<64, false>(200000);
+    Random<256, false>(200000);
+    Random<512, false>(200000);
+    Random<64, true>(200000);
+    Random<512, true>(200000);
+
+    // The oldest record is dropped by the consumer, after the failed push
+    static RecordQueue<64, true> queue;
+    uint8_t data[20] = { 0 };
+    for(uint8_t i = 0; i < 3; ++i) {
+        data[0] = i;
+        CHECK(queue.Push(data, sizeof(data)));
+    }
+    data[0] = 3;
+    CHECK(!queue.Push(data, sizeof(data)));
+    uint8_t len;
+    const uint8_t* ptr = queue.Peek(len);
+    CHECK(ptr && len == sizeof(data) && ptr[0] == 1);
+    queue.Release();
+    CHECK(queue.Push(data, sizeof(data)));
+    CHECK(queue.Push(data, sizeof(data)));
+    ptr = queue.Peek(len);
+    CHECK(ptr && ptr[0] == 2);
+    return Test::Result("record_queue");
+}
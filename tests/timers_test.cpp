@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// TIM1/TIM2/TIM4 on the simulated counters: Host::AdvanceTimers counts fMASTER ticks through
+// the prescalers, update and compare interrupts are served as they occur.
+
+#include "timers.h"
+#include "check.h"
+
+using namespace Mcudrv;
+
+namespace {
+
+unsigned t1Updates, t2Updates, t2Compares, t4Updates;
+
+void T1Update()
+{
+    T1::Timer1::ClearIntFlag(T1::IRQ_Update);
+    ++t1Updates;
+}
+void T2Update()
+{
+    T2::Timer2::ClearIntFlag(T2::IRQ_Update);
+    ++t2Updates;
+}
+void T2Compare()
+{
+    T2::Timer2::ClearIntFlag(T2::IRQ_Ch2);
+    ++t2Compares;
+}
+void T4Update()
+{
+    T4::Timer4::ClearIntFlag();
+    ++t4Updates;
+}
+
+} // namespace
+
+int main()
+{
+    Host::Reset();
+    Host::AttachIsr(TIM1_OVR_UIF_vector, T1Update);
+    Host::AttachIsr(TIM2_OVR_UIF_vector, T2Update);
+    Host::AttachIsr(TIM2_CAPCOM_CC1IF_vector, T2Compare);
+    Host::AttachIsr(TIM4_OVR_UIF_vector, T4Update);
+    __enable_interrupt();
+
+    // TIM2: fMASTER / 4, 100 counts a period, compare match on Ch2 once a period
+    T2::Timer2::Init(T2::Div_4, T2::CEN);
+    T2::Timer2::WriteAutoReload(99);
+    T2::Timer2::WriteCompareWord<T2::Ch2>(50);
+    CHECK(T2::Timer2::ReadCompareWord<T2::Ch2>() == 50);
+    T2::Timer2::EnableInterrupt(T2::Ints(T2::IRQ_Update | T2::IRQ_Ch2));
+    Host::AdvanceTimers(4 * 100 * 3 + 4 * 10);
+    CHECK(t2Updates == 3 && t2Compares == 3 && T2::Timer2::ReadCounter() == 10);
+    Host::AdvanceTimers(4 * 41);
+    CHECK(t2Compares == 4 && t2Updates == 3);
+
+    // TIM1: 16 bit prescaler, fMASTER / 100, 10 counts a period
+    T1::Timer1::Init(100, T1::CEN);
+    T1::Timer1::WriteAutoReload(9);
+    T1::Timer1::EnableInterrupt(T1::IRQ_Update);
+    Host::AdvanceTimers(5000);
+    CHECK(t1Updates == 5);
+
+    // TIM4: 8 bit, fMASTER / 2, 10 counts a period
+    T4::Timer4::Init(T4::Div_2, T4::CEN);
+    T4::Timer4::WriteAutoReload(9);
+    T4::Timer4::EnableInterrupt();
+    Host::AdvanceTimers(200);
+    CHECK(t4Updates == 10);
+
+    // With interrupts masked the flags stay pending and are served once on enable
+    __disable_interrupt();
+    T1::Timer1::Disable();
+    T2::Timer2::Disable();
+    const unsigned t4 = t4Updates;
+    Host::AdvanceTimers(100);
+    CHECK(t4Updates == t4 && T4::Timer4::CheckIntStatus());
+    __enable_interrupt();
+    Host::Poll();
+    CHECK(t4Updates == t4 + 1 && !T4::Timer4::CheckIntStatus());
+
+    // A stopped timer doesn't count
+    const uint16_t cnt = T2::Timer2::ReadCounter();
+    Host::AdvanceTimers(1000);
+    CHECK(T2::Timer2::ReadCounter() == cnt && t1Updates == 5);
+
+    return Test::Result("timers");
+}
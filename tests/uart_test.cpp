@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// UartIrq on the simulated UART1: received bytes are queued with Host::UartReceive (receive errors are
+// injected with it) and the line goes idle (IDLE flag) after the queue drains, transmitted ones are
+// collected by the TX callback.
+
+#include "uart.h"
+#include "check.h"
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace Mcudrv;
+using namespace Mcudrv::Uarts;
+
+namespace {
+
+typedef UartIrq<16, 16> Plain;
+typedef UartIrq<16, 64, Nullpin, 0, 4> Framed;
+
+std::string sent;
+void OnTx(uint8_t c)
+{
+    sent += char(c);
+}
+std::vector<uint16_t> messages;
+void OnMessage(uint16_t len)
+{
+    messages.push_back(len);
+}
+
+template<typename Uart>
+void Setup()
+{
+    Host::Reset();
+    Host::SetUartTxCallback(OnTx);
+    Host::AttachIsr(UART1_T_TXE_vector, Uart::TxISR);
+    Host::AttachIsr(UART1_R_RXNE_vector, Uart::RxISR);
+    Uart::template Init<DefaultCfg, 9600>();
+    Uart::Flush();
+    sent.clear();
+    __enable_interrupt();
+}
+
+void Receive(const char* s)
+{
+    while(*s) {
+        Host::UartReceive(*s++);
+    }
+    Host::Poll();
+}
+
+template<typename Uart>
+std::string ReadAll()
+{
+    std::string got;
+    uint8_t c;
+    while(Uart::Getch(c)) {
+        got += char(c);
+    }
+    return got;
+}
+template<typename Uart>
+std::string ReadMessage(uint16_t maxLen = 16)
+{
+    uint8_t buf[16];
+    return std::string((const char*)buf, Uart::GetMessage(buf, maxLen));
+}
+
+} // namespace
+
+int main()
+{
+    // Plain mode: interrupt driven in and out, IDLE interrupt stays off
+    Setup<Plain>();
+    CHECK(UART1->BRR1 == 0x0D && UART1->BRR2 == 0x00);
+    CHECK(!(UART1->CR2 & UART1_CR2_ILIEN) && (UART1->CR2 & UART1_CR2_RIEN));
+    Plain::Puts("hello");
+    Host::Poll();
+    CHECK(sent == "hello" && !(UART1->CR2 & UART1_CR2_TIEN));
+    Receive("abc");
+    std::string got;
+    uint8_t c;
+    while(Plain::Getch(c)) {
+        got += char(c);
+    }
+    CHECK(got == "abc");
+    CHECK(UART1->SR & UART1_SR_IDLE); // raised, but nobody listens
+    // A burst longer than the buffer: the excess is dropped and counted
+    Receive("0123456789abcdefXYZ");
+    got.clear();
+    while(Plain::Getch(c)) {
+        got += char(c);
+    }
+    CHECK(got == "0123456789abcdef" && Plain::GetRxStats().overflow == 3);
+
+    // IDLE framing: the gap after each burst closes a message
+    Setup<Framed>();
+    CHECK(UART1->CR2 & UART1_CR2_ILIEN);
+    CHECK(!Framed::GetMessageLength());
+    Receive("first");
+    CHECK(Framed::GetMessageLength() == 5 && !(UART1->SR & UART1_SR_IDLE));
+    Receive("second!");
+    uint8_t buf[16];
+    CHECK(Framed::GetMessage(buf, sizeof(buf)) == 5 && !memcmp(buf, "first", 5));
+    CHECK(Framed::GetMessage(buf, sizeof(buf)) == 7 && !memcmp(buf, "second!", 7));
+    CHECK(!Framed::GetMessage(buf, sizeof(buf)) && !Framed::Getch(c));
+
+    // The callback reports each message, only the stored bytes of an overflowed one are counted
+    Framed::SetRxCallback(OnMessage);
+    Framed::ClearRxStats();
+    Receive(std::string(70, 'x').c_str());
+    CHECK(messages.size() == 1 && messages[0] == 64 && Framed::GetRxStats().overflow == 6);
+    CHECK(ReadMessage<Framed>() == std::string(16, 'x') && !Framed::GetMessageLength());
+    // With RxMsgCount boundaries pending, the next message is merged with the following one
+    messages.clear();
+    const char* const burst[] = { "a", "b", "c", "d", "e" };
+    for(uint8_t i = 0; i < 5; ++i) {
+        Receive(burst[i]);
+    }
+    CHECK(messages.size() == 4 && ReadMessage<Framed>() == "a");
+    Receive("f");
+    CHECK(messages.size() == 5 && messages[4] == 2);
+    CHECK(ReadMessage<Framed>() == "b" && ReadMessage<Framed>() == "c" && ReadMessage<Framed>() == "d");
+    CHECK(ReadMessage<Framed>() == "ef");
+    // The rest of a message longer than maxLen is dropped
+    Receive("truncated");
+    Receive("ok");
+    CHECK(ReadMessage<Framed>(5) == "trunc" && ReadMessage<Framed>() == "ok");
+    // Flush drops the pending messages and bytes
+    Receive("x");
+    Receive("y");
+    Framed::Flush();
+    CHECK(!Framed::GetMessageLength() && ReadAll<Framed>().empty());
+    Receive("z");
+    CHECK(ReadMessage<Framed>() == "z");
+
+    // Receive errors are counted, the byte is kept
+    Setup<Plain>();
+    Plain::ClearRxStats();
+    Host::UartReceive('p', UART1_SR_PE);
+    Host::UartReceive('f', UART1_SR_FE);
+    Host::UartReceive('n', UART1_SR_NF | UART1_SR_OR);
+    Host::Poll();
+    const Plain::RxStats& stats = Plain::GetRxStats();
+    CHECK(ReadAll<Plain>() == "pfn");
+    CHECK(stats.parityErr == 1 && stats.frameErr == 1 && stats.noiseErr == 1 && stats.overrunErr == 1);
+    CHECK(!stats.overflow);
+
+    // A divider found by AutoBaud (19200 here) is kept by Init until ClearAutoBaud
+    Internal::AutoBaudState<>::divider = 2000000UL / 19200;
+    Plain::Init<DefaultCfg, 9600>();
+    CHECK(UART1->BRR1 == 0x06 && UART1->BRR2 == 0x08);
+    Uart::ClearAutoBaud();
+    Plain::Init<DefaultCfg, 9600>();
+    CHECK(UART1->BRR1 == 0x0D && UART1->BRR2 == 0x00);
+
+    return Test::Result("uart");
+}
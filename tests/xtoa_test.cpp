@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2017 Dmytro Shestakov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// io::xtoa: output checked against sprintf, the reciprocal quotient by 10 against the division, and
+// the decimal entry point benchmarked against the division loop it replaced. The host divides by a
+// constant with a multiply, so the host times show the shift-and-add quotient at its worst; on STM8
+// the 32-bit division it replaces is a library call. No STM8 cycle counts: no simulator here.
+// io::Print with the Dec/Fixed/Hex formats is checked as well.
+
+#include "string_utils.h"
+#include "check.h"
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+struct StringSink
+{
+    char buf[32];
+    uint8_t len;
+    void Putch(uint8_t c)
+    {
+        buf[len++] = char(c);
+        buf[len] = '\0';
+    }
+};
+
+template<typename... Args>
+bool Prints(const char* expected, const Args&... args)
+{
+    StringSink sink = { { 0 }, 0 };
+    io::Print(sink, args...);
+    if(strcmp(sink.buf, expected)) {
+        printf("  printed \"%s\", expected \"%s\"\n", sink.buf, expected);
+        return false;
+    }
+    return true;
+}
+
+// The former base 10 conversion: digits by division, then reversal
+template<typename T>
+uint8_t* DivXtoa(T value, uint8_t* result)
+{
+    typedef typename stdx::make_unsigned<T>::type UT;
+    uint8_t* out = result;
+    UT quotient = stdx::is_negative(value) ? UT(UT(0) - UT(value)) : UT(value);
+    do {
+        const UT q = quotient / 10;
+        *out++ = uint8_t('0' + (quotient - q * 10));
+        quotient = q;
+    } while(quotient);
+    if(stdx::is_negative(value)) {
+        *out++ = '-';
+    }
+    uint8_t* end = out;
+    *out-- = '\0';
+    while(result < out) {
+        const uint8_t c = *out;
+        *out-- = *result;
+        *result++ = c;
+    }
+    return end;
+}
+
+volatile uint8_t sink; // keeps the benchmarked loops alive
+
+template<typename T>
+T Sample(uint32_t i)
+{
+    // spread over the whole range, small values included
+    const uint32_t x = i * 2654435761UL;
+    return T(x >> (i % (sizeof(T) * 8)));
+}
+
+template<typename T>
+void Bench(const char* name, unsigned count)
+{
+    typedef std::chrono::steady_clock Clock;
+    uint8_t buf[16];
+    unsigned long digits = 0;
+    Clock::time_point start = Clock::now();
+    for(unsigned i = 0; i < count; ++i) {
+        DivXtoa(Sample<T>(i), buf);
+        sink = buf[0];
+    }
+    const double divNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / count;
+    start = Clock::now();
+    for(unsigned i = 0; i < count; ++i) {
+        io::xtoa(Sample<T>(i), buf);
+        sink = buf[0];
+    }
+    const double recNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / count;
+    for(unsigned i = 0; i < count; ++i) {
+        const uint8_t* end = io::xtoa(Sample<T>(i), buf);
+        digits += end - buf - (buf[0] == '-');
+    }
+    printf("  %-8s divide %6.1f ns  reciprocal %6.1f ns  %4.2f digits per value\n", name, divNs, recNs,
+           double(digits) / count);
+}
+
+} // namespace
+
+int main()
+{
+    uint8_t buf[16];
+    char ref[16];
+    for(uint32_t i = 0; i < 0x10000UL; ++i) {
+        CHECK(io::Internal::Div10(uint16_t(i)) == i / 10);
+        CHECK(io::Internal::Div10(uint8_t(i)) == uint8_t(i) / 10);
+    }
+    for(uint32_t i = 0; i < 4000000UL; ++i) {
+        const uint32_t v = i * 1073UL + (i >> 3);
+        CHECK(io::Internal::Div10(v) == v / 10);
+        CHECK(io::Internal::Div10(~v) == ~v / 10);
+    }
+    for(long i = -70000; i < 70000; ++i) {
+        const int32_t v = int32_t(i * 30677);
+        io::xtoa(v, buf);
+        sprintf(ref, "%ld", (long)v);
+        CHECK(!strcmp((char*)buf, ref));
+    }
+    for(long i = 0; i < 65536; ++i) {
+        const uint8_t* end = io::xtoa(uint16_t(i), buf);
+        sprintf(ref, "%lu", (unsigned long)i);
+        CHECK(!strcmp((char*)buf, ref) && end == buf + strlen(ref));
+        io::xtoa(int16_t(i), buf);
+        sprintf(ref, "%d", int(int16_t(i)));
+        CHECK(!strcmp((char*)buf, ref));
+    }
+    for(int i = -128; i < 128; ++i) {
+        io::xtoa(int8_t(i), buf);
+        sprintf(ref, "%d", i);
+        CHECK(!strcmp((char*)buf, ref));
+    }
+    io::xtoa(uint32_t(4294967295UL), buf);
+    CHECK(!strcmp((char*)buf, "4294967295"));
+    io::xtoa(int32_t(-2147483647L - 1), buf);
+    CHECK(!strcmp((char*)buf, "-2147483648"));
+    io::xtoa(uint16_t(0xBEEF), buf, 16);
+    CHECK(!strcmp((char*)buf, "beef"));
+    CHECK(!strcmp((char*)io::InsertDot(1234, 2, buf), "12.34"));
+    CHECK(!strcmp((char*)io::InsertDot(5, 2, buf), "0.05"));
+
+    CHECK(Prints("-5 65535 -2147483648", -5L, ' ', uint16_t(65535), ' ', int32_t(-2147483647L - 1)));
+    CHECK(Prints("   42|00042|-0042", io::Dec<5>(42), '|', io::Dec<5, '0'>(42), '|', io::Dec<5, '0'>(int8_t(-42))));
+    CHECK(Prints("12.34 -0.05 0.5 100.0", io::Fixed<2>(1234), ' ', io::Fixed<2>(int16_t(-5)), ' ',
+                 io::Fixed<1>(uint8_t(5)), ' ', io::Fixed<1>(1000U)));
+    CHECK(Prints("  1.5|-001.5", io::Fixed<1, 5>(15), '|', io::Fixed<1, 6, '0'>(-15)));
+    // fraction as long as the type's digits or longer
+    CHECK(Prints("0.255", io::Fixed<3>(uint8_t(255))));
+    CHECK(Prints("0.0005", io::Fixed<4>(uint8_t(5))));
+    CHECK(Prints("-0.128", io::Fixed<3>(int8_t(-128))));
+    CHECK(Prints("0.00005", io::Fixed<5>(uint16_t(5))));
+    CHECK(Prints("0.0000000001", io::Fixed<10>(uint32_t(1))));
+    CHECK(Prints("  0.005", io::Fixed<3, 7>(uint8_t(5))));
+    CHECK(Prints("00BE 7F", io::Hex<4>(uint8_t(0xBE)), ' ', io::Hex<2>(uint8_t(0x7F))));
+
+    printf("xtoa: base 10, division loop against the reciprocal\n");
+    Bench<uint8_t>("uint8", 1000000);
+    Bench<uint16_t>("uint16", 1000000);
+    Bench<int16_t>("int16", 1000000);
+    Bench<uint32_t>("uint32", 1000000);
+    Bench<int32_t>("int32", 1000000);
+    return Test::Result("xtoa");
+}
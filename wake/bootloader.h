@@ -27,6 +27,15 @@
 #include "flash.h"
 #include "bootloaderDefines.h"
 
+// CRC engine of the bootloader, table-less by default to keep it small
+#ifndef BOOTLOADER_CRC
+#define BOOTLOADER_CRC Crc8_NoLUT
+#endif
+
+// Define to take the baudrate from BOOTSTART_KEY sent by the host (see Uart::AutoBaud), the value is
+// the number of polls ProcessHandshake waits for the start bit. TIM2 is used for the measurement.
+//#define BOOTLOADER_AUTOBAUD 20000U
+
 #define WAKEDATABUFSIZE 140
 
 #define UBC_END 0x8600UL
@@ -45,6 +54,7 @@ namespace Mcudrv {
 
 #define VECTOR(N) ((interrupt_handler_t)(UBC_END + N * 4))
 
+#if !defined(MCUDRV_HOST)
     extern "C" {
 		void __iar_program_start();
 		}
@@ -84,6 +94,7 @@ namespace Mcudrv {
       {0x8200, VECTOR(30)}, /* irq28 */
       {0x8200, VECTOR(31)}, /* irq29 */
     };
+#endif
 
 		enum {
 			BOOTLOADER_VER = 0x02
@@ -157,16 +168,85 @@ namespace Mcudrv {
         uint8_t buf[WAKEDATABUFSIZE];
     };
 
+    // Flash and EEPROM programming primitives of the bootloader.
+    // Memory is addressed by plain 16-bit addresses, so the bootloader can be built
+    // against an alternative implementation, e.g. a simulated memory image with
+    // byte/word/block programming timings for the host flashing tool tests.
+    template<McuId DeviceID>
+    struct BootFlash
+    {
+      enum {
+        BLOCK_SIZE = DeviceID >= ID_STM8S105C6 ? 128 : 64
+      };
+      FORCEINLINE static void Unlock()
+      {
+        Mem::Unlock<Mem::Flash>();
+        Mem::Unlock<Mem::Eeprom>();
+      }
+      FORCEINLINE static void Lock()
+      {
+        Mem::Lock<Mem::Flash>();
+        Mem::Lock<Mem::Eeprom>();
+      }
+      FORCEINLINE static uint8_t Read(uint16_t addr)
+      {
+        return *(uint8_t*)addr;
+      }
+      FORCEINLINE static void WaitWriteDone()
+      {
+        while((FLASH->IAPSR & (FLASH_IAPSR_EOP | FLASH_IAPSR_WR_PG_DIS)) == 0)
+          ;
+      }
+      FORCEINLINE static void WriteByte(uint16_t addr, uint8_t value)
+      {
+        *(uint8_t*)addr = value;
+        WaitWriteDone();
+      }
+      // addr must be word (4 bytes) aligned
+      FORCEINLINE static void WriteWord(uint16_t addr, const uint8_t* data)
+      {
+        FLASH->CR2 |= FLASH_CR2_WPRG;
+        FLASH->NCR2 &= ~FLASH_NCR2_NWPRG;
+        for(uint8_t i = 0; i < 4; ++i) {
+          ((uint8_t*)addr)[i] = data[i];
+        }
+        WaitWriteDone();
+      }
+      // addr must be block aligned, executed from RAM as the flash is stalled during block programming
+      __ramfunc static void WriteBlock(uint16_t addr, const uint8_t* data)
+      {
+        /* Standard block programming mode */
+        FLASH->CR2 |= FLASH_CR2_PRG;
+        FLASH->NCR2 &= ~FLASH_NCR2_NPRG;
+
+        /* Copy data bytes from RAM to FLASH memory */
+        for(u16 Count = 0; Count < BLOCK_SIZE; ++Count) {
+          ((uint8_t*)addr)[Count] = data[Count];
+        }
+#if defined(STM8S105) && 0
+        if(addr > UBC_END) {
+          /* Waiting until High voltage flag is cleared*/
+          while(FLASH->IAPSR & 0x40)
+            ;
+        }
+#endif /* STM8S105 */
+      }
+    };
+
+    // FlashMem - memory programming primitives (see BootFlash)
+    // Transport - byte link with the Uarts::Uart polling interface
     template<McuId DeviceID, Uarts::BaudRate baud = 9600UL,
-             typename DriverEnable = Pd6>
+             typename DriverEnable = Pd6,
+             typename FlashMem = BootFlash<DeviceID>,
+             typename Transport = Uarts::Uart>
 		class Bootloader
 		{
 		private:
 			typedef BootTraits<DeviceID> Traits;
-			typedef Uarts::Uart Uart;
+			typedef Transport Uart;
 			enum {
 				SingleWireMode = Uart::BaseAddr == UART1_BaseAddress ? Uarts::SingleWireMode : 0,
-				BLOCK_SIZE = DeviceID >= ID_STM8S105C6 ? 128 : 64,
+				BLOCK_SIZE = FlashMem::BLOCK_SIZE,
 				BLOCK_BYTES = BLOCK_SIZE,
 				FLASH_START = Traits::FlashStart,
 				EEPROM_START = Traits::EepromStart
@@ -200,30 +280,12 @@ namespace Mcudrv {
 				ERR_EEPROMUNLOCK //EEPROM wasn't unlocked
 			};
 			static Packet packet_;
-			static Crc::Crc8_NoLUT crc_;
+			static Crc::BOOTLOADER_CRC crc_;
 			static uint8_t prevByte_;
 			static State state_;            //Current tranfer mode
 			static uint8_t rxBufPtr_;				//data pointer in Rx buffer
 			static uint8_t cmd_;
-			static uint8_t* memPtr_;
-			__ramfunc static void WriteFlashBlock(u8** data)
-			{
-				/* Standard block programming mode */
-				FLASH->CR2 |= FLASH_CR2_PRG;
-				FLASH->NCR2 &= ~FLASH_CR2_PRG;
-
-				/* Copy data bytes from RAM to FLASH memory */
-				for(u16 Count = 0; Count < BLOCK_SIZE; ++Count) {
-					*memPtr_++ = *((*data)++);
-				}
-#if defined(STM8S105) && 0
-				if((uint16_t)memPtr_ > FLASH_START) {
-					/* Waiting until High voltage flag is cleared*/
-					while(FLASH->IAPSR & 0x40)
-						;
-				}
-#endif /* STM8S105 */
-			}
+			static uint16_t memAddr_;
 			FORCEINLINE static void GetInfo()
 			{
 				//check if key valid
@@ -245,54 +307,44 @@ namespace Mcudrv {
 				u8 DataCount = packet_.n;
 				u8* DataPointer = packet_.buf;
 				//program beginning bytes before words
-				while(((uint16_t)memPtr_ % 4) && (DataCount))
+				while((memAddr_ % 4) && (DataCount))
 				{
-					*memPtr_++ = *DataPointer++;
-					while((FLASH->IAPSR & (FLASH_IAPSR_EOP | FLASH_IAPSR_WR_PG_DIS)) == 0)
-						;
+					FlashMem::WriteByte(memAddr_++, *DataPointer++);
 					DataCount--;
 				}
 				//program beginning words before blocks
-				while(((uint16_t)memPtr_ % BLOCK_BYTES) && (DataCount >= 4))
+				while((memAddr_ % BLOCK_BYTES) && (DataCount >= 4))
 				{
-					FLASH->CR2 |= (u8)0x40;
-					FLASH->NCR2 &= (u8)~0x40;
-					for(uint8_t i = 0; i < 4; ++i) {
-						*memPtr_++ = *DataPointer++;
-					}
-					while((FLASH->IAPSR & (FLASH_IAPSR_EOP | FLASH_IAPSR_WR_PG_DIS)) == 0)
-						;
+					FlashMem::WriteWord(memAddr_, DataPointer);
+					memAddr_ += 4;
+					DataPointer += 4;
 					DataCount -= 4;
 				}
 				//program blocks
 				while(DataCount >= BLOCK_BYTES)
 				{
-					WriteFlashBlock(&DataPointer);
+					FlashMem::WriteBlock(memAddr_, DataPointer);
+					memAddr_ += BLOCK_BYTES;
+					DataPointer += BLOCK_BYTES;
 					DataCount -= BLOCK_BYTES;
 				}
 				//program remaining words (after blocks)
 				while(DataCount >= 4)
 				{
-					FLASH->CR2 |= (u8)0x40;
-					FLASH->NCR2 &= (u8)~0x40;
-					for(uint8_t i = 0; i < 4; ++i) {
-						*memPtr_++ = *DataPointer++;
-					}
-					while( (FLASH->IAPSR & (FLASH_IAPSR_EOP | FLASH_IAPSR_WR_PG_DIS)) == 0)
-						;
+					FlashMem::WriteWord(memAddr_, DataPointer);
+					memAddr_ += 4;
+					DataPointer += 4;
 					DataCount -= 4;
 				}
 				//program remaining bytes (after words)
 				while(DataCount)
 				{
-					*memPtr_++ = *DataPointer++;
-					while( (FLASH->IAPSR & (FLASH_IAPSR_EOP | FLASH_IAPSR_WR_PG_DIS)) == 0)
-						;
+					FlashMem::WriteByte(memAddr_++, *DataPointer++);
 					DataCount--;
 				}
 				packet_.n = 3;
 				packet_.buf[0] = ERR_NO;
-				*(uint16_t*)&packet_.buf[1] = (uint16_t)memPtr_;
+				*(uint16_t*)&packet_.buf[1] = memAddr_;
 			}
 			FORCEINLINE static void SetPosition()
 			{
@@ -302,13 +354,13 @@ namespace Mcudrv {
 					packet_.n = 1;
 					return;
 				}
-				bool eepromFlag = packet_.buf[0] & 0x80;
+				bool eepromFlag = *(uint16_t*)packet_.buf & 0x8000U;
 				//set flash address
 				if(!eepromFlag) {
 					uint16_t addr = *(uint16_t*)packet_.buf + FLASH_START;
 					//address is valid
 					if(addr < Traits::FlashEnd) {
-						memPtr_ = (uint8_t*)addr;
+						memAddr_ = addr;
 						packet_.buf[0] = ERR_NO;
 						*(uint16_t*)&packet_.buf[1] = addr;
 						packet_.n = 3;
@@ -320,7 +372,7 @@ namespace Mcudrv {
 					uint16_t addr = (*(uint16_t*)packet_.buf & ~0x8000U) + EEPROM_START;
 					//address is valid
 					if(addr < Traits::EepromEnd) {
-						memPtr_ = (uint8_t*)addr;
+						memAddr_ = addr;
 						packet_.buf[0] = ERR_NO;
 						*(uint16_t*)&packet_.buf[1] = addr;
 						packet_.n = 3;
@@ -342,17 +394,17 @@ namespace Mcudrv {
 				//length of data to read
 				uint8_t length = packet_.buf[0];
 				//Get End position of selected memory type
-				const uint16_t memEnd = (uint16_t)memPtr_ & 0x8000U ? Traits::FlashEnd : Traits::EepromEnd;
+				const uint16_t memEnd = memAddr_ & 0x8000U ? Traits::FlashEnd : Traits::EepromEnd;
 				//If requested more than remained, read only a remnant
-				if((uint16_t)memPtr_ + length > memEnd) {
-					length = memEnd - (uint16_t)memPtr_;
+				if(memAddr_ + length > memEnd) {
+					length = memEnd - memAddr_;
 				}
 				//Fill buffer
 				for(uint8_t i = 0; i < length; ++i) {
-					packet_.buf[i + BUF_OFFSET] = *memPtr_++;
+					packet_.buf[i + BUF_OFFSET] = FlashMem::Read(memAddr_++);
 				}
 				packet_.buf[0] = ERR_NO;
-				*(uint16_t*)&packet_.buf[1] = (uint16_t)memPtr_;
+				*(uint16_t*)&packet_.buf[1] = memAddr_;
 				packet_.n = length + BUF_OFFSET;
 			}
 			FORCEINLINE static void Receive()
@@ -510,14 +562,19 @@ namespace Mcudrv {
 			}
 			FORCEINLINE static void Deinit()
 			{
-				using namespace Mem;
-				Lock<Flash>();
-				Lock<Eeprom>();
+				FlashMem::Lock();
+#ifdef BOOTLOADER_AUTOBAUD
+				T2::Timer2::Init(T2::Div_1, T2::Default);
+#endif
 			}
 		public:
 			FORCEINLINE static bool ProcessHandshake()
 			{
+#ifdef BOOTLOADER_AUTOBAUD
+				if(Uart::template AutoBaud<BOOTSTART_KEY>(BOOTLOADER_AUTOBAUD)) {
+#else
 				if(Uart::IsEvent(Uarts::EvRxne) && Uart::Getch() == BOOTSTART_KEY) {
+#endif
 					DriverEnable::Set();
 					Uart::Putch(BOOTRESPONSE);
 					while(!Uart::IsEvent(Uarts::EvTxComplete))
@@ -530,24 +587,27 @@ namespace Mcudrv {
 			FORCEINLINE static void Go()
 			{
 				//simple check if user firmware exist
-				if((*((u8*)UBC_END)==0x82) || (*((u8*)UBC_END)==0xAC)) {
+				const uint8_t opcode = FlashMem::Read(UBC_END);
+				if(opcode == 0x82 || opcode == 0xAC) {
 					Deinit();
+#if defined(MCUDRV_HOST)
+					Host::Jump(UBC_END);
+#else
 					//reset stack pointer (lower byte - because compiler decreases SP with some bytes)
 					asm("LDW X,  SP ");
 					asm("LD  A,  $FF");
 					asm("LD  XL, A  ");
 					asm("LDW SP, X  ");
 					asm("JPF " UBC_END_ASM);
+#endif
 				}
 			}
 			FORCEINLINE static void Init()
 			{
 				using namespace Uarts;
-				using namespace Mem;
-				Unlock<Flash>();
-				Unlock<Eeprom>();
+				FlashMem::Unlock();
 				//Single Wire mode is default for UART1
-				Uart::template Init<Cfg(Uarts::DefaultCfg | (Cfg)SingleWireMode), 9600UL>();
+				Uart::template Init<Cfg(Uarts::DefaultCfg | (Cfg)SingleWireMode), baud>();
 				DriverEnable::Clear();
 				DriverEnable::template SetConfig<GpioBase::Out_PushPull_fast>();
 			}
@@ -595,20 +655,20 @@ namespace Mcudrv {
 			}
 		};
 
-    template<McuId DeviceID, Uarts::BaudRate baud, typename DriverEnable>
-    Packet Bootloader<DeviceID, baud, DriverEnable>::packet_;
-    template<McuId DeviceID, Uarts::BaudRate baud, typename DriverEnable>
-    Crc::Crc8_NoLUT Bootloader<DeviceID, baud, DriverEnable>::crc_;
-    template<McuId DeviceID, Uarts::BaudRate baud, typename DriverEnable>
-    uint8_t Bootloader<DeviceID, baud, DriverEnable>::prevByte_;
-    template<McuId DeviceID, Uarts::BaudRate baud, typename DriverEnable>
-    Bootloader<DeviceID, baud, DriverEnable>::State Bootloader<DeviceID, baud, DriverEnable>::state_;
-    template<McuId DeviceID, Uarts::BaudRate baud, typename DriverEnable>
-    uint8_t Bootloader<DeviceID, baud, DriverEnable>::rxBufPtr_;
-    template<McuId DeviceID, Uarts::BaudRate baud, typename DriverEnable>
-    uint8_t Bootloader<DeviceID, baud, DriverEnable>::cmd_;
-    template<McuId DeviceID, Uarts::BaudRate baud, typename DriverEnable>
-    uint8_t* Bootloader<DeviceID, baud, DriverEnable>::memPtr_ = (uint8_t*)UBC_END;
+    template<McuId DeviceID, Uarts::BaudRate baud, typename DriverEnable, typename FlashMem, typename Transport>
+    Packet Bootloader<DeviceID, baud, DriverEnable, FlashMem, Transport>::packet_;
+    template<McuId DeviceID, Uarts::BaudRate baud, typename DriverEnable, typename FlashMem, typename Transport>
+    Crc::BOOTLOADER_CRC Bootloader<DeviceID, baud, DriverEnable, FlashMem, Transport>::crc_;
+    template<McuId DeviceID, Uarts::BaudRate baud, typename DriverEnable, typename FlashMem, typename Transport>
+    uint8_t Bootloader<DeviceID, baud, DriverEnable, FlashMem, Transport>::prevByte_;
+    template<McuId DeviceID, Uarts::BaudRate baud, typename DriverEnable, typename FlashMem, typename Transport>
+    typename Bootloader<DeviceID, baud, DriverEnable, FlashMem, Transport>::State Bootloader<DeviceID, baud, DriverEnable, FlashMem, Transport>::state_;
+    template<McuId DeviceID, Uarts::BaudRate baud, typename DriverEnable, typename FlashMem, typename Transport>
+    uint8_t Bootloader<DeviceID, baud, DriverEnable, FlashMem, Transport>::rxBufPtr_;
+    template<McuId DeviceID, Uarts::BaudRate baud, typename DriverEnable, typename FlashMem, typename Transport>
+    uint8_t Bootloader<DeviceID, baud, DriverEnable, FlashMem, Transport>::cmd_;
+    template<McuId DeviceID, Uarts::BaudRate baud, typename DriverEnable, typename FlashMem, typename Transport>
+    uint16_t Bootloader<DeviceID, baud, DriverEnable, FlashMem, Transport>::memAddr_ = UBC_END;
 
   }//Wk
 }//Mcudrv
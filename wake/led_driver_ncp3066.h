@@ -25,6 +25,7 @@
 #include "wake_base.h"
 #include "gpio.h"
 #include "timers.h"
+#include "capture.h"
 
 //		MBI6651
 //	First Channel,	Fan Control
@@ -32,7 +33,9 @@
 //		NCP3066
 //	First Channel,				Fan Control
 //	PA3(TIM2_CH3) - On/Off		PD4(TIM2_CH1)
-//  PD3(TIM2_CH2) - driver NFB
+//  PD3(TIM2_CH2) - driver NFB		PC6(TIM1_CH1) - Fan tachometer
+//	PC6 is TIM1_CH1 only with AFR0 remap set in option byte OPT2 (STM8S103/003/903),
+//	without it the tachometer isn't started and FanTacho is cleared from the reported features.
 
 namespace Mcudrv
 {
@@ -44,7 +47,8 @@ namespace Mcudrv
 		enum
 		{
 			TwoChannels = false,
-			FanControl = true
+			FanControl = true,
+			FanTacho = true
 		};
 	};
 
@@ -86,6 +90,23 @@ namespace Mcudrv
 			C_SetFan = 20,
 			C_SetGfgFanAuto = 21
 		};
+		enum {
+			FanPulsesPerRev = 2,
+			TachoTickFreq = F_CPU / 16,		// TIM1 clock, 8us for 2 MHz
+			OptAfr0 = 0x01					// OPT2: PC5 - TIM2_CH1, PC6 - TIM1_CH1, PC7 - TIM1_CH2
+		};
+		// Fan tachometer (open drain output) on TIM1 CH1, TIM1 CH2 is taken for the falling edges
+		typedef Capture::PeriodMeter<T1::Timer1> Tacho;
+		_Pragma(VECTOR_ID(TIM1_CAPCOM_CC1IF_vector))
+		__interrupt static void TachoCaptureISR()
+		{
+			Tacho::CaptureIRQ();
+		}
+		_Pragma(VECTOR_ID(TIM1_OVR_UIF_vector))
+		__interrupt static void TachoUpdateISR()
+		{
+			Tacho::UpdateIRQ();
+		}
 		#pragma data_alignment=4
 		#pragma location=".eeprom.noinit"
 		static state_t state_nv;// @ ".eeprom.noinit";
@@ -106,6 +127,19 @@ namespace Mcudrv
 			uint8_t tmp = ReadSpeed();
 			return tmp > 20 ? (tmp - 20) / 2 : 0;
 		}
+		static bool TachoAvailable()
+		{
+#if defined(STM8S103) || defined(STM8S003) || defined(STM8S903)
+			return Features::FanTacho && (OPT->OPT2 & OptAfr0);
+#else
+			return false;	// no TIM1_CH1 on PC6
+#endif
+		}
+		// 0 - fan is stopped or has no tachometer output
+		static uint16_t GetFanRpm()
+		{
+			return Tacho::GetRate(TachoTickFreq) / FanPulsesPerRev;
+		}
 		static void SetFanSpeed(uint8_t speed)
 		{
 			if(speed > 100) speed = 255;
@@ -180,7 +214,7 @@ namespace Mcudrv
 		enum
 		{
 			deviceMask = DevLedDriver,
-			features = Features::TwoChannels | Features::FanControl << 1UL
+			features = Features::TwoChannels | Features::FanControl << 1UL | Features::FanTacho << 2UL
 		};
 		#pragma inline=forced
 		static void Init()
@@ -202,6 +236,11 @@ namespace Mcudrv
 				Timer2::SetChannelCfg<T2::Ch1, Output, channelConfig>();
 				Timer2::ChannelEnable<T2::Ch1>();
 			}
+			if(TachoAvailable()) {
+				Pc6::SetConfig<GpioBase::In_Pullup>();
+				T1::Timer1::Init(F_CPU / TachoTickFreq, T1::CEN);
+				Tacho::Init();
+			}
 		}
 		#pragma inline=forced
 		static void Process()
@@ -239,6 +278,12 @@ namespace Mcudrv
 						pdata.buf[1] = GetFanSpeed();
 						pdata.n = 2;
 					}
+					//fan RPM
+					else if(TachoAvailable() && pdata.buf[0] == 0x02) {
+						pdata.buf[0] = ERR_NO;
+						*(uint16_t*)&pdata.buf[1] = GetFanRpm();
+						pdata.n = 3;
+					}
 					else {
 						pdata.buf[0] = ERR_NI;
 						pdata.n = 1;
@@ -379,7 +424,7 @@ namespace Mcudrv
 		#pragma inline=forced
 		static uint8_t GetDeviceFeatures(const uint8_t)
 		{
-			return features;
+			return TachoAvailable() ? features : features & ~(Features::FanTacho << 2UL);
 		}
 		#pragma inline=forced
 		static void UpdIRQ()	//Soft Dimming
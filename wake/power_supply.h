@@ -25,9 +25,10 @@
 
 #include "wake_base.h"
 #include "gpio.h"
-#include "adc.h"
+#include "adc_scan.h"
 #include "hd44780.h"
-#include "string_utils.h"
+#include "fixed.h"
+#include "filters.h"
 #include "sensors.h"
 
 namespace Mcudrv {
@@ -59,46 +60,27 @@ namespace Mcudrv {
 		typedef Pd2 Vsen; //AIN3
         typedef Pd4 Ilim; //TIM2 CH1
 
-		typedef Adcs::Adc1 Adc;
-
 		static const Adcs::Channel VsenChannel = (Adcs::Channel)Adcs::PinToCh<Vsen>::value;
 		static const Adcs::Channel IsenChannel = (Adcs::Channel)Adcs::PinToCh<Isen>::value;
 
-		//32 samples simple moving average
-		enum { MA_SIZE = 1U << 5 };
-		static uint16_t rawVoltage[MA_SIZE];
-		static uint16_t rawCurrent[MA_SIZE];
+		//10 buffered samples of each channel per system tick, an ADC interrupt per channel
+		typedef Adcs::BurstEngine<VsenChannel, IsenChannel> Adc;
+		//Per tick sums: median of 3 drops spikes, EMA over ~16 ticks smooths the rest
+		typedef utils::Median<uint16_t, 3> SpikeFilter;
+		typedef utils::Ema<uint16_t, 4> AvgFilter;
+		static SpikeFilter voltageSpikes, currentSpikes;
+		static AvgFilter voltageAvg, currentAvg;
 
-		static uint16_t To_mA(uint16_t value)
+		//Conversions take 5 times the sum of 10 samples (AvgFilter::GetScaled<5>), the fraction bits
+		//of the average are dropped once, by the division here
+		static uint16_t To_mA(uint32_t value)
 		{
-			value = ((value * 5) / 32);
-			return  value > 9 ? value - 10 : 0;
+			const uint16_t mA = uint16_t(value / 32);
+			return  mA > 9 ? mA - 10 : 0;
 		}
-		static uint16_t ToTensOf_mV(uint16_t value)
+		static uint16_t ToTensOf_mV(uint32_t value)
 		{
-			return 1850U + ((value * 5) / 64);
-		}
-		_Pragma(VECTOR_ID(ADC1_EOC_vector))
-		__interrupt static void AdcISR()
-		{
-			Adc::ClearEvent(Adcs::EndOfConv);
-			Adc::Disable();
-			static uint8_t maIndex;
-			uint16_t result = 0;
-			for(uint8_t i = 0; i < 10; ++i) {
-				result += Adc::buffer[i];
-			}
-			if(Adc::GetSelectedChannel() == VsenChannel) {
-				rawVoltage[maIndex] = result;
-				Adc::SelectChannel(IsenChannel);
-			}
-			else {
-				rawCurrent[maIndex] = result;
-				Adc::SelectChannel(VsenChannel);
-				if(++maIndex == MA_SIZE) {
-					maIndex = 0;
-				}
-			}
+			return 1850U + uint16_t(value / 64);
 		}
 	public:
 		enum
@@ -119,10 +101,7 @@ namespace Mcudrv {
 			{	using namespace Adcs;
 				Isen::SetConfig<GpioBase::In_float>();
 				Vsen::SetConfig<GpioBase::In_float>();
-				Adc::DisableSchmittTrigger<IsenChannel | VsenChannel>();
-				Adc::SelectChannel((Channel)VsenChannel);
-				Adc::Init<Cfg(ADCEnable | ContMode | BufferEnable), Div2>();
-				Adc::EnableInterrupt(EndOfConv);
+				Adc::Init<Div2>();
 			}
 			{ using namespace T2;
 				Ilim::SetConfig<GpioBase::Out_PushPull_fast>();
@@ -191,19 +170,28 @@ namespace Mcudrv {
 		}
 		static void UpdIRQ()
 		{
-			Adc::Enable();
-			Adc::StartConversion();
+			static uint8_t seq;
+			if(seq != Adc::GetSequence()) {
+				seq = Adc::GetSequence();
+				uint16_t sums[2];
+				Adc::Snapshot(sums);
+				voltageSpikes.Update(sums[0]);
+				currentSpikes.Update(sums[1]);
+				voltageAvg.Update(voltageSpikes.Get());
+				currentAvg.Update(currentSpikes.Get());
+			}
+			Adc::Start();
 		}
 
 		static void VIRefresh()
 		{
-			uint32_t voltage = 0, current = 0;
-			for(uint8_t i = 0; i < MA_SIZE; ++i) {
-				voltage += rawVoltage[i];
-				current += rawCurrent[i];
-			}
-			vi.voltage = ToTensOf_mV(voltage >> 5);
-			vi.current = To_mA(current >> 5);
+			__istate_t state = __get_interrupt_state();
+			__disable_interrupt();
+			const uint32_t voltage = voltageAvg.GetScaled<5>();
+			const uint32_t current = currentAvg.GetScaled<5>();
+			__set_interrupt_state(state);
+			vi.voltage = ToTensOf_mV(voltage);
+			vi.current = To_mA(current);
 		}
 		static uint16_t GetVoltage()
 		{
@@ -213,10 +201,11 @@ namespace Mcudrv {
 		{
 			return vi.current;
 		}
+		// Tenths of watt. Integer product: 8 fractional bits of volts and amperes are too coarse for it
 		static uint16_t GetPower()
 		{
 			uint32_t power = (uint32_t)GetVoltage() * GetCurrent();
-			return uint16_t(power / 10000);
+			return uint16_t((power + 5000) / 10000);
 		}
 		static uint8_t GetLoad()
 		{
@@ -229,9 +218,11 @@ namespace Mcudrv {
 		}
 	};
 
-	uint16_t PowerSupply::rawVoltage[PowerSupply::MA_SIZE];
-	uint16_t PowerSupply::rawCurrent[PowerSupply::MA_SIZE];
 	PowerSupply::VI PowerSupply::vi;
+	PowerSupply::SpikeFilter PowerSupply::voltageSpikes;
+	PowerSupply::SpikeFilter PowerSupply::currentSpikes;
+	PowerSupply::AvgFilter PowerSupply::voltageAvg;
+	PowerSupply::AvgFilter PowerSupply::currentAvg;
 
 	class Display : public NullModule
 	{
@@ -241,47 +232,40 @@ namespace Mcudrv {
 		typedef Pc7 LcdE;
 		typedef Hd44780<LcdDataBus, LcdRs, LcdE> Lcd;
 		enum LcdPatterns { SymDegree };
-		volatile static bool updFlag;
+		enum { RefreshPeriod = SysTickFreq / 2 };
+		static void Redraw()
+		{
+			PowerSupply::VIRefresh();
+			Lcd::Clear();
+			io::Print<Lcd>(io::Fixed<2>(PowerSupply::GetVoltage()), 'V');
+			Lcd::SetPosition(10);
+			io::Print<Lcd>(io::Fixed<3>(PowerSupply::GetCurrent()), 'A');
+			Lcd::SetPosition(0, 1);
+			io::Print<Lcd>(io::Fixed<1>(PowerSupply::GetPower()), 'W');
+			Lcd::SetPosition(10, 1);
+			io::Print<Lcd>(io::Fixed<1>(Tsensor_LM75::ReadTemperature()));
+			Lcd::Putch(uint8_t(SymDegree));
+		}
 	public:
 		static void Init()
 		{
 			static const uint8_t degreePattern[8] = {0x1C, 0x14, 0x1C, 0};
 			Lcd::Init();
 			Lcd::BuildCustomChar(0, degreePattern);
+			SysTimers::Start(TmrDisplay, RefreshPeriod, Redraw, SoftTimers::Periodic); // ~2Hz
 		}
-		static void UpdIRQ()
-		{
-			updFlag = true;
-		}
+		// Periodic redraw is scheduled by the display timer and runs from Wake::Process,
+		// so the main loop poll has nothing left to do. Kept for the existing main loops.
 		static void Refresh()
+		{ }
+		// Redraws now, the next periodic redraw is due in RefreshPeriod
+		static void ForceRefresh()
 		{
-			if(updFlag) {
-				updFlag = false;
-				static uint8_t counter;
-				if(++counter & 0x20) { // div32 ~= 2Hz
-					counter = 0;
-					uint8_t buf[8];
-					PowerSupply::VIRefresh();
-					Lcd::Clear();
-					Lcd::Puts(io::InsertDot(PowerSupply::GetVoltage(), 2, buf));
-					Lcd::Putch('V');
-					Lcd::SetPosition(10);
-					Lcd::Puts(io::InsertDot(PowerSupply::GetCurrent(), 3, buf));
-					Lcd::Putch('A');
-					Lcd::SetPosition(0, 1);
-					Lcd::Puts(io::InsertDot(PowerSupply::GetPower(), 1, buf));
-					Lcd::Putch('W');
-					Lcd::SetPosition(10, 1);
-					Lcd::Puts(io::InsertDot(Tsensor_LM75::Read(), 1, buf));
-					Lcd::Putch(SymDegree);
-				}
-			}
+			SysTimers::Start(TmrDisplay, RefreshPeriod, Redraw, SoftTimers::Periodic);
+			Redraw();
 		}
-
 	};
 
-	volatile bool Display::updFlag;
-
 	}//Wk
 }//Mcudrv
 
@@ -25,6 +25,8 @@
 
 #include "wake_base.h"
 #include "i2c.h"
+#include "fixed.h"
+#include "filters.h"
 namespace Mcudrv {
 	namespace Wk {
 
@@ -47,16 +49,43 @@ namespace Mcudrv {
 		enum InstructionSet {
 			C_GetValue = 48
 		};
+		enum { SamplePeriod = SysTickFreq }; // ~1 s
+		static utils::Median<int16_t, 3> spikeFilter;
+		static utils::MinMax<int16_t> range;
 
+		// Run by SysTimers from Wake::Process, the filter sees evenly spaced samples whoever reads it
+		static void Sample()
+		{
+			spikeFilter.Update(Tsense::Read());
+			range.Update(spikeFilter.Get());
+		}
 	public:
 		enum { deviceMask = DevSensor, features = SenTemperature };
+		typedef utils::Fixed<int16_t, 1> Temperature; // 0.5 C resolution
 		static void Init()
 		{
             Twi::Init();
+			Sample();
+			SysTimers::Start(TmrSensors, SamplePeriod, Sample, SoftTimers::Periodic);
 		}
+		// Median of the last 3 samples, a single bad transfer doesn't show up
+		static Temperature ReadTemperature()
+		{
+			return Temperature::FromRaw(spikeFilter.Get());
+		}
+		// Lowest and highest temperature sampled since power up
+		static Temperature GetMinTemperature()
+		{
+			return Temperature::FromRaw(range.GetMin());
+		}
+		static Temperature GetMaxTemperature()
+		{
+			return Temperature::FromRaw(range.GetMax());
+		}
+		// Tenths of degree
 		static uint16_t Read()
 		{
-			return Tsense::Read() * 5;
+			return ReadTemperature().ToDecimal<1>();
 		}
 		static uint8_t GetDeviceFeatures(uint8_t)
 		{
@@ -88,6 +117,9 @@ namespace Mcudrv {
 		}
 	};
 
+	utils::Median<int16_t, 3> Tsensor_LM75::spikeFilter;
+	utils::MinMax<int16_t> Tsensor_LM75::range;
+
 	}//Wk
 }//Mcudrv
 
@@ -31,12 +31,28 @@
 #include "flash.h"
 #include "gpio.h"
 #include "itc.h"
+#include "idle.h"
 #include "iwdg.h"
+#include "soft_timer.h"
 #include "timers.h"
 #include "uart.h"
 
 namespace Mcudrv {
 namespace Wk {
+// Software timers ticked by TIM4 update, callbacks are run by Wake::Process
+enum SysTimerId
+{
+    TmrOpTime,
+    TmrDisplay,
+    TmrSensors,
+    TmrUser // first id for application modules
+};
+enum
+{
+    SysTickFreq = F_CPU / 128 / 256 // ~61 Hz for 2 MHz HSI
+};
+typedef SoftTimers::TimerWheel<TmrUser + WAKE_USER_TIMERS> SysTimers;
+
 //	---=== Operation time counter ===---
 template<typename TCallback>
 class OpTime
@@ -60,20 +76,32 @@ private:
     // Fcpu/256/128 ~= 61 Hz for 2 MHz HSI
     _Pragma(VECTOR_ID(TIM4_OVR_UIF_vector)) __interrupt static void UpdIRQ()
     {
-        static uint16_t tempCounter;
         T4::Timer4::ClearIntFlag();
-        if(++tempCounter == (600U * 61)) {
-            tempCounter = 0;
-            SetTenMinutesFlag();
+#if SYSCLOCK_MAX_SHIFT
+        // Tick rate is kept on a faster clock, TIM4 is at its longest period already
+        static uint8_t subTicks;
+        if(++subTicks & ((1U << SysClock::GetShift()) - 1)) {
+            return;
         }
+#endif
+        SysTimers::Tick();
         TCallback::UpdIRQ();
     }
+    static void MinutePassed()
+    {
+        static uint8_t minutes;
+        if(++minutes == 10) {
+            minutes = 0;
+            SetTenMinutesFlag();
+        }
+    }
 public:
 #pragma inline = forced
     static void Init()
     {
         using namespace T4;
         Itc::SetPriority(TIM4_OVR_UIF_vector, Itc::prioLevel_2_middle);
+        SysTimers::Start(TmrOpTime, 60U * SysTickFreq, MinutePassed, SoftTimers::Periodic);
         Timer4::Init(Div_128, CEN);
         Timer4::EnableInterrupt();
     }
@@ -366,7 +394,7 @@ private:
     static volatile uint8_t prev_byte;
     static volatile State state; // Current tranfer mode
     static volatile uint8_t ptr; // data pointer in Rx buffer
-    static Crc::Crc8 crc;
+    static Crc::WAKE_CRC crc;
 
     static void SetAddress(const AddrType nodeOrGroup) // and get address
     {
@@ -448,6 +476,7 @@ public:
     {
         using namespace Mem;
         Mcudrv::Iwdg::Refresh();
+        SysTimers::Dispatch();
         if(OpTime::GetTenMinitesFlag() && !IsActive()) {
             OpTime::ClearTenMinutesFlag();
             OpTime::CountInc(); // Refresh optime counter every 10 mins
@@ -593,10 +622,20 @@ public:
         }
     }
 
+    // A frame is being received or a received one isn't processed yet
 #pragma inline = forced
     static bool IsActive()
     {
-        return state != WAIT_FEND;
+        return state != WAIT_FEND || cmd != C_NOP;
+    }
+    // SysClock::ClockManager listener
+    static void BeforeClockChange()
+    {
+        Uarts::ClockSync<Uart, baud>::BeforeClockChange();
+    }
+    static void OnClockChange(int8_t scale)
+    {
+        Uarts::ClockSync<Uart, baud>::OnClockChange(scale);
     }
 
     static void Send()
@@ -606,7 +645,7 @@ public:
         char data_byte = FEND;
         crc.Reset(CRC_INIT); //инициализация CRC,
         crc(data_byte);      //обновление CRC
-        Uart::Regs()->DR = data_byte;
+        Uart::WriteData(data_byte);
         state = ADDR;
         prev_byte = TFEND;
         Uart::DisableInterrupt(IrqRxne);
@@ -632,13 +671,13 @@ public:
             if(prev_byte == FEND) {
                 data_byte = TFEND; // send TFEND instead FEND
                 prev_byte = data_byte;
-                Uart::Regs()->DR = data_byte;
+                Uart::WriteData(data_byte);
                 return;
             }
             if(prev_byte == FESC) {
                 data_byte = TFESC; // send TFESC instead FESC
                 prev_byte = data_byte;
-                Uart::Regs()->DR = data_byte;
+                Uart::WriteData(data_byte);
                 return;
             }
             switch(state) {
@@ -678,7 +717,7 @@ public:
             prev_byte = data_byte; // store pre-byte
             if(data_byte == FEND)
                 data_byte = FESC; // send FESC if byte stuffing required
-            Uart::Regs()->DR = data_byte;
+            Uart::WriteData(data_byte);
         }
     }
 
@@ -691,7 +730,7 @@ public:
     {
         using namespace Uarts;
         bool error = Uart::IsEvent(static_cast<Events>(EvParityErr | EvFrameErr | EvNoiseErr | EvOverrunErr));
-        uint8_t data_byte = Uart::Regs()->DR;
+        uint8_t data_byte = Uart::ReadData();
         if(error) {
             state = WAIT_FEND; // wait for new packet
             cmd = C_ERR;       // send error status
@@ -793,6 +832,26 @@ volatile State Wake<moduleList, baud, DEpin, mode>::state;
 template<typename moduleList, Uarts::BaudRate baud, typename DEpin, Mode mode>
 volatile uint8_t Wake<moduleList, baud, DEpin, mode>::ptr;
 template<typename moduleList, Uarts::BaudRate baud, typename DEpin, Mode mode>
-Crc::Crc8 Wake<moduleList, baud, DEpin, mode>::crc;
+Crc::WAKE_CRC Wake<moduleList, baud, DEpin, mode>::crc;
+
+// Idle manager of Wake nodes on SysTimers, main loop: Wake::Process(); WakeIdle<Wake>::Sleep();
+// Halt is taken only between frames and with PWM outputs stopped. The first byte after a halt is lost,
+// so unless WAKE_HALT_WAKEUP_BY_FEND is set (all masters precede frames with an extra FEND) the node
+// stays out of halt while the receiver is on, i.e. only WFI is used. Module UpdIRQ() isn't called for
+// the ticks slept in halt, only SysTimers are advanced. Halts are kept within WAKE_IWDG_PERIOD by default.
+template<typename WakeT,
+         uint16_t MaxSleepTicks = Power::WatchdogSleepTicks<Iwdg::Period(WAKE_IWDG_PERIOD), SysTickFreq>::value,
+         typename... Busy>
+struct WakeIdle
+  : Power::IdleManager<SysTimers,
+                       SysTickFreq,
+                       stdx::conditional<UART_SINGLEWIRE_MODE, Uarts::Uart::TxPin, Uarts::Uart::RxPin>::type,
+                       MaxSleepTicks,
+                       Power::UartTxActive<Uarts::Uart>,
+                       stdx::conditional<WAKE_HALT_WAKEUP_BY_FEND, Power::NeverActive, Power::UartRxEnabled<Uarts::Uart> >::type,
+                       Power::PwmActive,
+                       WakeT,
+                       Busy...>
+{ };
 } // Wk
 } // Mcudrv
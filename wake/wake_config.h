@@ -31,11 +31,37 @@
 #define BOOTLOADER_EXIST 0
 #endif
 
+// CRC engine used by the Wake protocol, any Crc8 flavour from crc.h:
+// Crc8 (256 bytes table), Crc8_Nibble (16 bytes table), Crc8_Bitwise or Crc8_NoLUT (no table)
+#ifndef WAKE_CRC
+#define WAKE_CRC Crc8
+#endif
+
 // TX will be used also as RX, supported only in UART1
 #ifndef UART_SINGLEWIRE_MODE
 #define UART_SINGLEWIRE_MODE 0
 #endif
 
+// Nodes may enter Active-halt with the receiver on: the byte waking the node is lost, so every master
+// on the bus has to send an extra FEND before each frame. Otherwise WakeIdle uses WFI only: with the
+// receiver on all the time, a node never halts.
+// Low-power node: WAKE_HALT_WAKEUP_BY_FEND 1, masters sending the extra FEND, WakeIdle::Init() and
+// SetHaltEnabled(true) after Wake::Init(), PWM timers stopped while idle (PwmActive keeps the node
+// out of halt otherwise) and WAKE_IWDG_PERIOD matching the watchdog, see tests/idle_test.cpp.
+#ifndef WAKE_HALT_WAKEUP_BY_FEND
+#define WAKE_HALT_WAKEUP_BY_FEND 0
+#endif
+
+// IWDG period (Iwdg::Period) the application sets, WakeIdle keeps halts within it
+#ifndef WAKE_IWDG_PERIOD
+#define WAKE_IWDG_PERIOD Iwdg::P_1s
+#endif
+
+// Software timers available to modules beside the system ones, see SysTimers in wake_base.h
+#ifndef WAKE_USER_TIMERS
+#define WAKE_USER_TIMERS 4
+#endif
+
 enum CustomDeviceID
 {
     CustomID_Themostat = 0x01